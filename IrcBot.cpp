@@ -18,15 +18,19 @@
  */
 
 #include <IrcBot.h>
+#ifdef IRC_NETWORK_DNSCLIENT
+#include <Dns.h>
+#endif
 
 
-const uint32_t IrcBot::version = 0x00000100;
-const char *IrcBot::versionString = "v1.0";
+const uint32_t IrcBotBase::version = 0x00000100;
+const char *IrcBotBase::versionString = "v1.0";
 
-IrcBot::IrcBot(Stream *debugStream, const char *server, const char *nick, const char *user, const char *desc)
+IrcBotBase::IrcBotBase(const IrcBotStorage &tables, Stream *debugStream, const char *server, const char *nick, const char *user, const char *desc)
 {
+	useTables(tables);
 	Dbg = debugStream;
-	strncpy(_ircnick, nick, IRC_NICKUSER_MAXLEN-1);
+	strncpy(_ircwantnick, nick, IRC_NICKUSER_MAXLEN-1);
 	strncpy(_ircuser, user, IRC_NICKUSER_MAXLEN-1);
 	strncpy(_ircdescription, desc, IRC_DESCRIPTION_MAXLEN-1);
 	strncpy(_ircserver, server, IRC_SERVERNAME_MAXLEN-1);
@@ -34,10 +38,11 @@ IrcBot::IrcBot(Stream *debugStream, const char *server, const char *nick, const
 	InitVariables();
 }
 
-IrcBot::IrcBot(void)
+IrcBotBase::IrcBotBase(const IrcBotStorage &tables)
 {
+	useTables(tables);
 	Dbg = &Serial;
-	strncpy(_ircnick, "MyTivaLP", IRC_NICKUSER_MAXLEN-1);
+	strncpy(_ircwantnick, "MyTivaLP", IRC_NICKUSER_MAXLEN-1);
 	strncpy(_ircuser, "tm4c129", IRC_NICKUSER_MAXLEN-1);
 	strncpy(_ircdescription, "Energia Warrior", IRC_DESCRIPTION_MAXLEN-1);
 	strncpy(_ircserver, "chat.freenode.net", IRC_SERVERNAME_MAXLEN-1);
@@ -45,27 +50,115 @@ IrcBot::IrcBot(void)
 	InitVariables();
 }
 
-void IrcBot::InitVariables(void)
+void IrcBotBase::useTables(const IrcBotStorage &tables)
+{
+	chan_max = tables.channels;
+	_ircchannels = tables.channelNames;
+	_ircchankeys = tables.channelKeys;
+	chanState = tables.chanState;
+	chanHashSlots = ircHashSlots(chan_max);
+	chanHash = tables.chanHash;
+	chanHashIndex = tables.chanHashIndex;
+	channelJoinCallbacks = tables.joinCallbacks;
+	channelPartCallbacks = tables.partCallbacks;
+	usercb_max = tables.userCallbacks;
+	channelUserJoinCallbacks = tables.userJoinCallbacks;
+	channelUserPartCallbacks = tables.userPartCallbacks;
+	cmd_max = tables.commands;
+	commandHashSlots = ircHashSlots(cmd_max);
+	commandCallbackRegistry = tables.commandRegistry;
+	commandHashIndex = tables.commandHashIndex;
+	ringbuf_size = tables.ingressLen;
+	ringbuf = tables.ringbuf;
+	txbuf_size = tables.egressLen;
+	txbuf = tables.txbuf;
+	txq_lines = tables.queueLines;
+	txq_size = tables.queueLen;
+	txq = tables.txq;
+	txq_buf = tables.txqBuf;
+#if IRC_MEMBERS_MAX > 0
+	members_max = tables.members;
+	nicks_max = tables.nicks;
+	nickHashSlots = nicks_max ? ircHashSlots(nicks_max) : 0;
+	memberHashSlots = members_max ? ircHashSlots(members_max) : 0;
+	nickTable = tables.nickTable;
+	nickHashIndex = tables.nickHashIndex;
+	memberTable = tables.memberTable;
+	memberHashIndex = tables.memberHashIndex;
+	chanMembers = tables.chanMembers;
+	chanMemberCount = tables.chanMemberCount;
+	chanNamesActive = tables.chanNamesActive;
+#endif
+}
+
+void IrcBotBase::InitVariables(void)
 {
 	int i;
 
 	// Initialize all variables to defaults
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
+	_loglevel = IRC_LOG_LEVEL;
+	casefold_last = 0;  // setCaseMapping() (from isupportReset() below) builds the channel index
+	memset(chanHashIndex, 0, chanHashSlots * sizeof(chanHashIndex[0]));
+	for (i=0; i < chan_max; i++) {
 		_ircchannels[i][0] = '\0';
+		_ircchankeys[i][0] = '\0';
 		chanState[i] = IRC_CHAN_NOTJOINED;
 		channelJoinCallbacks[i].callback = NULL;
 		channelJoinCallbacks[i].userobj = NULL;
 		channelPartCallbacks[i].callback = NULL;
 		channelPartCallbacks[i].userobj = NULL;
 	}
-	ringbuf_start = 0;
-	ringbuf_end = 0;
+	ringBufferReset();
+	memset(&ingress, 0, sizeof(ingress));
+	throttle_millis = 0;
+	_ircpass[0] = '\0';
+	_ircwantnick[IRC_NICKUSER_MAXLEN-1] = '\0';
+	strcpy(_ircnick, _ircwantnick);
+	nick_attempts = 0;
+	nick_baselen = 0;
+	cap_wanted = cap_available = cap_enabled = 0;
+	cap_negotiating = false;
+	sasl_mech = IRC_SASL_NONE;
+	sasl_status = IRC_SASL_IDLE;
+	memberReset();   // Before isupportReset(): setCaseMapping() re-indexes the nick table
+	isupportReset();
+#if IRC_MEMBERS_MAX > 0
+	member_overflows = 0;
+#endif
+	self_prefixlen = 0;
+	_saslacct[0] = '\0';
+	_saslpass[0] = '\0';
+	reconnect_delay = 0;
+	reconnect_attempts = 0;
+	registered_millis = 0;
+	// Seed from the clock and our own address so bots started together still draw different jitter
+	rng_state = (uint32_t)micros() ^ (uint32_t)(uintptr_t)this ^ 0x9E3779B9UL;
+	if (rng_state == 0)
+		rng_state = 1;
+	reconnectPolicy.initialDelay = IRC_RECONNECT_INITIAL;
+	reconnectPolicy.maxDelay = IRC_RECONNECT_MAX;
+	reconnectPolicy.jitterPercent = IRC_RECONNECT_JITTER;
+	reconnectPolicy.stableTime = IRC_RECONNECT_STABLE;
+	reconnectCallback = NULL;
+	reconnectCallbackUserobj = NULL;
+	namesCallback = NULL;
+	namesCallbackUserobj = NULL;
+	dns_valid = false;
+	flood_burst = IRC_FLOOD_BURST_LINES;
+	flood_msperline = IRC_FLOOD_MS_PER_LINE;
+	flood_bytespersec = IRC_FLOOD_BYTES_PER_SEC;
+	flood_fair = false;
+	egressReset();
+	txq_drops = 0;
+	txbuf_hold = false;
 	_enabled = true;
 	botState = IRC_DISCONNECTED;
 
 	connectCallback = disconnectCallback = NULL;
 	connectCallbackUserobj = disconnectCallbackUserobj = NULL;
-	for (i=0; i < IRC_CALLBACK_MAX_CHANNELNICK; i++) {
+	replyCallback = NULL;
+	replyCallbackUserobj = NULL;
+	for (i=0; i < usercb_max; i++) {
 		channelUserJoinCallbacks[i].chanidx = -1;
 		channelUserJoinCallbacks[i].callback = NULL;
 		channelUserJoinCallbacks[i].userobj = NULL;
@@ -77,25 +170,416 @@ void IrcBot::InitVariables(void)
 		channelUserPartCallbacks[i].nick[0] = '\0';
 	}
 
-	for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-		commandCallbackRegistry[i].cmd = NULL;
-		commandCallbackRegistry[i].callback = NULL;
-		commandCallbackRegistry[i].userobj = NULL;
-		commandCallbackRegistry[i].authnicks = NULL;
+	commandCount = 0;
+	memset(commandHashIndex, 0, commandHashSlots * sizeof(commandHashIndex[0]));
+}
+
+/* Egress line builder */
+
+void IrcBotBase::lineAppend(const char *str)
+{
+	unsigned int room;
+
+	if (!egressLineRoom())
+		return;
+	room = isupport.linelen - 2 - txbuf_line;  // Always keep space for the \r\n
+	while (*str != '\0' && room--)
+		txbuf[txbuf_len + txbuf_line++] = *str++;
+}
+
+void IrcBotBase::lineAppend(const char *str, unsigned int len)
+{
+	unsigned int room;
+
+	if (!egressLineRoom())
+		return;
+	room = isupport.linelen - 2 - txbuf_line;
+	if (len > room)
+		len = room;
+	memcpy(txbuf + txbuf_len + txbuf_line, str, len);
+	txbuf_line += len;
+}
+
+void IrcBotBase::lineAppend(const char c)
+{
+	char str[2] = { c, '\0' };
+
+	lineAppend(str);
+}
+
+/* Called before appending; at the start of a line, makes sure a full-length line fits behind whatever is
+ * already pending.  If the socket won't take enough of the backlog to make room, the whole line is
+ * dropped rather than written over unsent bytes.
+ */
+boolean IrcBotBase::egressLineRoom(void)
+{
+	if (txbuf_line == 0 && !txbuf_drop && txbuf_len + IRC_EGRESS_LINE_MAX > txbuf_size) {
+		egressFlush();
+		if (txbuf_len + IRC_EGRESS_LINE_MAX > txbuf_size)
+			txbuf_drop = true;
+	}
+	return !txbuf_drop;
+}
+
+// A line that had no room in txbuf; counts as a drop and clears the way for the next one.
+boolean IrcBotBase::egressLineDropped(void)
+{
+	if (!txbuf_drop)
+		return false;
+	txbuf_drop = false;
+	txbuf_line = 0;
+	txq_drops++;
+	if (IRC_LOGGING(IRC_LOG_WARN))
+		Dbg->println("lineEnd: egress buffer full; line dropped");
+	return true;
+}
+
+/* Finish a normal lane line.  It goes straight out if nothing is queued ahead of it and flood control
+ * has credit; otherwise it waits in the queue for loop() to drain.  Returns false if it had to be dropped.
+ */
+boolean IrcBotBase::lineEnd(const char *target)
+{
+	uint8_t *line = txbuf + txbuf_len;
+	unsigned int len;
+
+	if (egressLineDropped() || txbuf_line == 0)
+		return false;
+	line[txbuf_line++] = '\r';
+	line[txbuf_line++] = '\n';
+	len = txbuf_line;
+	txbuf_line = 0;
+
+	if (txq_pending == 0 && floodAllow(len)) {
+		floodCharge(len);
+		txbuf_len += len;
+		if (!txbuf_hold)
+			egressFlush();
+		return true;
+	}
+	return egressEnqueue(line, len, target);
+}
+
+// Finish a line that must not wait behind user traffic; it still uses up flood control credit.
+void IrcBotBase::lineEndPriority(void)
+{
+	if (egressLineDropped() || txbuf_line == 0)
+		return;
+	txbuf[txbuf_len + txbuf_line++] = '\r';
+	txbuf[txbuf_len + txbuf_line++] = '\n';
+	floodRefill();
+	floodCharge(txbuf_line);
+	txbuf_len += txbuf_line;
+	txbuf_line = 0;
+	if (!txbuf_hold)
+		egressFlush();
+}
+
+void IrcBotBase::egressFlush(void)
+{
+	unsigned int i;
+
+	if (txbuf_len == 0)
+		return;
+	i = conn.write(txbuf, txbuf_len);
+	if (i > txbuf_len)
+		i = 0;
+	if (i == 0)
+		return;
+	if (i != txbuf_len && IRC_LOGGING(IRC_LOG_DEBUG)) {
+		Dbg->print("egressFlush: wrote "); Dbg->print(i); Dbg->print(" of "); Dbg->println(txbuf_len);
+	}
+	// Keep the unsent tail, and any partially assembled line behind it, at the front for the next loop()
+	txbuf_len -= i;
+	if (txbuf_len + txbuf_line > 0)
+		memmove(txbuf, txbuf + i, txbuf_len + txbuf_line);
+}
+
+void IrcBotBase::egressReset(void)
+{
+	txbuf_len = 0;
+	txbuf_line = 0;
+	txbuf_drop = false;
+	txq_head = txq_count = txq_pending = 0;
+	txq_tail = 0;
+	// A new connection starts with a full bucket
+	flood_linetokens = flood_burst * flood_msperline;
+	flood_bytetokens = (flood_bytespersec > IRC_EGRESS_LINE_MAX ? flood_bytespersec : IRC_EGRESS_LINE_MAX) * 1000UL;
+	flood_millis = millis();
+}
+
+/* Flood control token buckets.  Line credit is kept in milliseconds (one line costs flood_msperline and
+ * up to flood_burst lines can be banked); byte credit is kept x1000 and refills flood_bytespersec per
+ * second, banking at least one full line's worth.
+ */
+void IrcBotBase::floodRefill(void)
+{
+	uint32_t now = millis(), elapsed = now - flood_millis, cap;
+
+	flood_millis = now;
+	if (flood_msperline) {
+		cap = flood_burst * flood_msperline;
+		if (elapsed >= cap - flood_linetokens)
+			flood_linetokens = cap;
+		else
+			flood_linetokens += elapsed;
+	}
+	if (flood_bytespersec) {
+		cap = (flood_bytespersec > IRC_EGRESS_LINE_MAX ? flood_bytespersec : IRC_EGRESS_LINE_MAX) * 1000UL;
+		if (elapsed >= (cap - flood_bytetokens) / flood_bytespersec)
+			flood_bytetokens = cap;
+		else
+			flood_bytetokens += elapsed * flood_bytespersec;
+	}
+}
+
+boolean IrcBotBase::floodAllow(unsigned int len)
+{
+	floodRefill();
+	if (flood_msperline && flood_linetokens < flood_msperline)
+		return false;
+	if (flood_bytespersec && flood_bytetokens < len * 1000UL)
+		return false;
+	return true;
+}
+
+void IrcBotBase::floodCharge(unsigned int len)
+{
+	if (flood_msperline)
+		flood_linetokens = (flood_linetokens > flood_msperline) ? flood_linetokens - flood_msperline : 0;
+	if (flood_bytespersec)
+		flood_bytetokens = (flood_bytetokens > len * 1000UL) ? flood_bytetokens - len * 1000UL : 0;
+}
+
+/* Queue a finished line.  Records form a ring in txq; their bytes are allocated contiguously from the
+ * ring txq_buf, wrapping to the front when a line won't fit at the end.  Space is reclaimed as sent
+ * records reach the head.
+ */
+boolean IrcBotBase::egressEnqueue(const uint8_t *line, unsigned int len, const char *target)
+{
+	unsigned int i, slot, off, headoff;
+	IrcQueuedLine *q;
+	uint16_t hash = 0;
+	uint8_t round = 0;
+
+	if (txq_count == txq_lines)
+		goto drop;
+	if (txq_count == 0) {
+		off = 0;
+		if (len > txq_size)
+			goto drop;
+	} else {
+		headoff = txq[txq_head].offset;
+		if (txq_tail > headoff) {  // Free space is [tail, end) and [0, head)
+			if (txq_tail + len <= txq_size)
+				off = txq_tail;
+			else if (len < headoff)
+				off = 0;
+			else
+				goto drop;
+		} else {  // Wrapped; free space is [tail, head)
+			if (txq_tail + len < headoff)
+				off = txq_tail;
+			else
+				goto drop;
+		}
+	}
+
+	if (target != NULL) {
+		hash = ircCommandHash(target);
+		for (i=0; i < txq_count; i++) {
+			q = &txq[(txq_head + i) % txq_lines];
+			if (q->len && q->target == hash && round < 255)
+				round++;
+		}
 	}
+	memcpy(txq_buf + off, line, len);
+	slot = (txq_head + txq_count) % txq_lines;
+	txq[slot].offset = off;
+	txq[slot].len = len;
+	txq[slot].target = hash;
+	txq[slot].round = round;
+	txq_count++;
+	txq_pending++;
+	txq_tail = off + len;
+	return true;
+
+drop:
+	txq_drops++;
+	if (IRC_LOGGING(IRC_LOG_WARN))
+		Dbg->println("egressEnqueue: outbound queue full; line dropped");
+	return false;
 }
 
-void IrcBot::writebuf(const uint8_t *buf)
+/* Move queued lines into txbuf for as long as flood control allows.  Lines go in queue order, or with
+ * fairness on, the oldest line among those with the fewest lines queued ahead of them for their target.
+ * all = true ignores flood control and empties the queue (used on the way out by end()).
+ * Must only be called between lines (txbuf_line == 0).
+ */
+void IrcBotBase::egressDrain(boolean all)
 {
-	conn.write(buf, strlen((const char *)buf));
+	unsigned int i, slot, best;
+	IrcQueuedLine *q;
+
+	while (txq_pending > 0) {
+		best = txq_lines;
+		for (i=0; i < txq_count; i++) {
+			slot = (txq_head + i) % txq_lines;
+			if (txq[slot].len == 0)
+				continue;
+			if (best == txq_lines || txq[slot].round < txq[best].round)
+				best = slot;
+			if (!flood_fair)
+				break;
+		}
+		q = &txq[best];
+		if (!all && !floodAllow(q->len))
+			break;
+		if (txbuf_len + q->len > txbuf_size) {
+			egressFlush();
+			if (txbuf_len + q->len > txbuf_size)
+				break;  // Socket is backed up; the line stays queued
+		}
+		memcpy(txbuf + txbuf_len, txq_buf + q->offset, q->len);
+		txbuf_len += q->len;
+		floodCharge(q->len);
+		q->len = 0;
+		txq_pending--;
+
+		while (txq_count > 0 && txq[txq_head].len == 0) {
+			txq_head = (txq_head + 1) % txq_lines;
+			txq_count--;
+		}
+	}
+	if (txq_count == 0)
+		txq_tail = 0;
 }
 
 /* Main loop where all the processing happens */
-static uint32_t millis_throttle = 0;
 
-void IrcBot::loop(void)
+void IrcBotBase::loop(void)
+{
+	// Hold outbound lines (replies, PONGs, JOINs) until this pass is done so they share a write
+	txbuf_hold = true;
+	processLoop();
+	if (botState > IRC_CONNECTING)
+		egressDrain();
+	txbuf_hold = false;
+	egressFlush();
+}
+
+/* How long loop() can go without being called, provided the socket isn't readable.  Lets an event loop
+ * (see IrcBotPool) sleep on many bots' sockets and only service the ones with something to do.
+ */
+unsigned long IrcBotBase::pollTimeout(void)
+{
+	uint32_t elapsed, wait = IRC_POLL_IDLE, w;
+	unsigned int i;
+
+	if (!_enabled)
+		return IRC_POLL_IDLE;
+
+	switch (botState) {
+		case IRC_DISCONNECTED:
+			elapsed = millis() - throttle_millis;
+			return elapsed >= reconnect_delay ? 0 : reconnect_delay - elapsed;
+
+		case IRC_CONNECTING:
+#ifdef IRC_NETWORK_ASYNC_CONNECT
+			// Writability wakes us when the handshake completes; otherwise wake for the timeout
+			elapsed = millis() - connect_millis;
+			return elapsed > IRC_CONNECT_TIMEOUT ? 0 : IRC_CONNECT_TIMEOUT + 1 - elapsed;
+#else
+			return 0;
+#endif
+
+		case IRC_MOTD_FINISHED:
+			for (i=0; i < (unsigned int)chan_max; i++) {
+				if (chanState[i] == IRC_CHAN_NOTJOINED && _ircchannels[i][0] != '\0')
+					return 0;
+			}
+			break;
+	}
+
+	// Queued lines: wait until flood control has credit for the oldest one
+	if (txq_pending > 0) {
+		for (i=0; i < txq_count; i++) {
+			if (txq[(txq_head + i) % txq_lines].len)
+				break;
+		}
+		i = txq[(txq_head + i) % txq_lines].len;
+		floodRefill();
+		wait = 0;
+		if (flood_msperline && flood_linetokens < flood_msperline)
+			wait = flood_msperline - flood_linetokens;
+		if (flood_bytespersec && flood_bytetokens < i * 1000UL) {
+			w = (i * 1000UL - flood_bytetokens + flood_bytespersec - 1) / flood_bytespersec;
+			if (w > wait)
+				wait = w;
+		}
+	}
+	return wait;
+}
+
+boolean IrcBotBase::hasInput(void)
+{
+	if (!_enabled || botState < IRC_CONNECTING)
+		return false;
+	if (botState == IRC_CONNECTING)
+		return true;  // Let loop() check on the handshake
+	return conn.available() > 0 || !conn.connected();
+}
+
+boolean IrcBotBase::pollWritable(void)
+{
+	if (!_enabled || botState < IRC_CONNECTING)
+		return false;
+	return botState == IRC_CONNECTING || txbuf_len > 0;
+}
+
+/* Server address, from the cache while it's fresh.  If a refresh fails the old address is kept and
+ * used, since the server is more likely to still be there than not.
+ */
+boolean IrcBotBase::resolveServer(void)
+{
+	IPAddress ip;
+	uint32_t now = millis();
+
+	if (dns_valid && now - dns_millis < IRC_DNS_CACHE_TTL)
+		return true;
+	if (IRC_NETWORK_RESOLVE(_ircserver, ip) == 1) {
+		_ircserverip = ip;
+		dns_valid = true;
+		dns_millis = now;
+		return true;
+	}
+	if (dns_valid && IRC_LOGGING(IRC_LOG_WARN))
+		Dbg->println("DNS lookup failed; using previous server address");
+	return dns_valid;
+}
+
+#ifdef IRC_NETWORK_DNSCLIENT
+// Energia's EthernetClient only resolves names inside connect(); do the lookup ourselves so it can be cached.
+int ircDnsResolve(const char *host, IPAddress &ip)
+{
+	DNSClient dns;
+
+	dns.begin(Ethernet.dnsServerIP());
+	return dns.getHostByName(host, ip);
+}
+#endif
+
+int IrcBotBase::getSocket(void)
+{
+#if defined(ENERGIA) || defined(ARDUINO)
+	return -1;
+#else
+	return conn.fd();
+#endif
+}
+
+void IrcBotBase::processLoop(void)
 {
-	int i = 0, j = 0;
+	int i = 0;
 
 	if (!_enabled)
 		return;
@@ -103,14 +587,17 @@ void IrcBot::loop(void)
 	/* Handle bot-state matters first */
 	if (botState > IRC_CONNECTING) {
 		if (!conn.connected()) {
-			Dbg->println("Found TCP connection closed; setting to IRC_DISCONNECTED");
+			if (IRC_LOGGING(IRC_LOG_INFO)) {
+				Dbg->println("Found TCP connection closed; setting to IRC_DISCONNECTED");
+			}
 			botState = IRC_DISCONNECTED;
 			// If registered, run OnDisconnect callback
 			executeOnDisconnectCallback();
-			millis_throttle = millis();  // 2-second throttle for reconnect
+			scheduleReconnect();
 		} else {
 			if (conn.available() || ringBufferLen() > 0) {
-				Dbg->println("processInboundData()");
+				if (IRC_LOGGING(IRC_LOG_TRACE))
+					Dbg->println("processInboundData()");
 				processInboundData();
 				if (!_enabled)
 					return;
@@ -121,70 +608,80 @@ void IrcBot::loop(void)
 	switch (botState) {
 		case IRC_DISCONNECTED:
 			if (conn.connected() ) {
-				Dbg->println("Network shows us connected");
+				if (IRC_LOGGING(IRC_LOG_INFO))
+					Dbg->println("Network shows us connected");
 				botState++;
 			} else {
-				if ( (millis() - millis_throttle) > 2000 ) {  // 2-second throttle between connect attempts
-					Dbg->println("Attempting to connect-");
-					Dbg->print("conn.connect(\""); Dbg->print(_ircserver);
-					Dbg->print("\", "); Dbg->print(_ircport); Dbg->println(");");
-					i = conn.connect(_ircserver, _ircport);
-					Dbg->print("conn.connect() return status = "); Dbg->println(i);
+				if (millis() - throttle_millis >= reconnect_delay) {
+					if (!resolveServer()) {
+						if (IRC_LOGGING(IRC_LOG_WARN)) {
+							Dbg->print("Unable to resolve "); Dbg->println(_ircserver);
+						}
+						scheduleReconnect();
+						return;
+					}
+					if (IRC_LOGGING(IRC_LOG_INFO)) {
+						Dbg->print("Attempting to connect to "); Dbg->print(_ircserver); Dbg->print(" (");
+						for (i=0; i < 4; i++) {
+							Dbg->print(_ircserverip[i]);
+							if (i < 3)
+								Dbg->print('.');
+						}
+						Dbg->print("), port "); Dbg->println(_ircport);
+					}
+#ifdef IRC_NETWORK_ASYNC_CONNECT
+					i = conn.connectAsync(_ircserverip, _ircport);
+					if (i >= 0) {  // Connected, or handshake under way
+#else
+					i = conn.connect(_ircserverip, _ircport);
 					if (i == 1) {  // Connect() successful
-						for (i=0; i < IRC_CHANNEL_MAX; i++)
+#endif
+						for (i=0; i < chan_max; i++)
 							chanState[i] = IRC_CHAN_NOTJOINED;
-						ringbuf_start = ringbuf_end = 0;
+						ringBufferReset();
+						egressReset();
+						isupportReset();
+						memberReset();
+						self_prefixlen = 0;
 						_hasmotd = false;
+						connect_millis = millis();
 						botState++;
 					} else {
-						Dbg->println("Connection attempt unsuccessful; trying again in 2 seconds");
-						millis_throttle = millis();  // Add 2-second throttle for reconnect
+						if (IRC_LOGGING(IRC_LOG_WARN)) {
+							Dbg->print("Connection attempt unsuccessful ("); Dbg->print(i); Dbg->println(")");
+						}
+						dns_millis = millis() - IRC_DNS_CACHE_TTL;  // Server may have moved; look it up again next time
+						scheduleReconnect();
 					}
 				}
 			}
 			return;
 
 		case IRC_CONNECTING:
-			if (conn.connected()) {
-				Dbg->println("Network shows us connected");
-				botState++;
+#ifdef IRC_NETWORK_ASYNC_CONNECT
+			i = conn.connectPoll();
+#else
+			i = conn.connected() ? 1 : 0;
+#endif
+			if (i > 0) {
+				if (IRC_LOGGING(IRC_LOG_INFO))
+					Dbg->println("Network shows us connected");
+				sendRegistration();
+				botState = IRC_REGISTERING;
 				// If registered, run the "Connect" callback.
 				executeOnConnectCallback();
+			} else if (i < 0 || millis() - connect_millis > IRC_CONNECT_TIMEOUT) {
+				if (IRC_LOGGING(IRC_LOG_WARN))
+					Dbg->println("Connection attempt failed or timed out");
+				conn.stop();
+				dns_millis = millis() - IRC_DNS_CACHE_TTL;
+				botState = IRC_DISCONNECTED;
+				scheduleReconnect();
 			}
 			return;
 
-		// In between these two is IRC_CONNECTED; processInboundData will get us past that once the server responds.
-
-		case IRC_SERVERINIT:  // Server has responded with something (anything); proceed to register nickname
-			char abuf[IRC_NICKUSER_MAXLEN+7];
-			strcpy(abuf, "NICK ");
-			strcat(abuf, _ircnick);
-			strcat(abuf, "\r\n");
-			writebuf(abuf);
-			botState++;
-			Dbg->print(">> Registering nick ("); Dbg->print(_ircnick); Dbg->println(")-");
-			nick_user_millis = millis();
-			return;
-
-		case IRC_REGISTERING_NICK:
-			if (millis()-nick_user_millis > 500)
-				botState++;
-			return;
-
-		case IRC_NICK_REGISTERED:  // Nick is confirmed registered; submit USER
-			char bbuf[IRC_NICKUSER_MAXLEN*2+IRC_SERVERNAME_MAXLEN+IRC_DESCRIPTION_MAXLEN+11];
-			strcpy(bbuf, "USER ");
-			strcat(bbuf, _ircuser);
-			strcat(bbuf, " 0 * :");
-			strcat(bbuf, _ircdescription);
-			strcat(bbuf, "\r\n");
-			writebuf(bbuf);
-			botState++;
-			Dbg->println(">> Registering user-");
-			return;
-
-		/* In between these is IRC_REGISTERING_USER and IRC_USER_REGISTERED; processInboundData will get us past this
-		 * once we confirm our user information has been received & processed.
+		/* In between these are IRC_REGISTERING and IRC_REGISTERED; processInboundData will get us past them
+		 * as the welcome (001) and end of MOTD arrive.
 		 */
 
 		case IRC_MOTD_FINISHED:
@@ -199,32 +696,167 @@ void IrcBot::loop(void)
 
 	/* Bot is connected and operating (presumably) normally; process data & rejoin channels if needed */
 	// Check for disconnected channels
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (chanState[i] == IRC_CHAN_NOTJOINED) {
-			if (_ircchannels[i][0] != '\0') {
-				// Channel defined; attempt to join!
-				char buf[IRC_CHANNEL_MAXLEN+7];
-				strcpy(buf, "JOIN ");
-				strcat(buf, _ircchannels[i]);
-				strcat(buf, "\r\n");
-				writebuf(buf);
-				chanState[i]++;
-			} /* IRC channel defined or not */
-		} /* IRC_CHAN_NOTJOINED */
+	sendJoins();
+}
+
+/* Join every channel we should be in but aren't, packed into as few "JOIN #a,#b,#c keya,keyb" lines as
+ * TARGMAX and the line length allow.  Keys pair up with channels by position, so keyed channels go
+ * first in each line.
+ */
+void IrcBotBase::sendJoins(void)
+{
+	char chans[IRC_EGRESS_LINE_MAX], keys[IRC_EGRESS_LINE_MAX];
+	unsigned int chanlen = 0, keylen = 0, count = 0, max = targetMax(IRC_CMDTOKEN_JOIN), n, k;
+	int i, keyed;
+
+	for (keyed = 1; keyed >= 0; keyed--) {
+		for (i=0; i < chan_max; i++) {
+			if (chanState[i] != IRC_CHAN_NOTJOINED || _ircchannels[i][0] == '\0' || (_ircchankeys[i][0] != '\0') != keyed)
+				continue;
+			if (!channelAllowed(i)) {
+				if (IRC_LOGGING(IRC_LOG_WARN)) {
+					Dbg->print("Not joining "); Dbg->print(_ircchannels[i]); Dbg->println("; server won't allow it");
+				}
+				chanState[i] = IRC_CHAN_UNAVAILABLE;
+				continue;
+			}
+			n = strlen(_ircchannels[i]);
+			k = strlen(_ircchankeys[i]);
+			// "JOIN " chans ' ' keys "\r\n"
+			if (count > 0 && (count == max || 5 + chanlen + 1 + n + 1 + keylen + 1 + k + 2 > isupport.linelen)) {
+				lineAppend("JOIN ");
+				lineAppend(chans, chanlen);
+				if (keylen > 0) {
+					lineAppend(' ');
+					lineAppend(keys, keylen);
+				}
+				lineEnd();
+				chanlen = keylen = count = 0;
+			}
+			if (count > 0)
+				chans[chanlen++] = ',';
+			memcpy(chans + chanlen, _ircchannels[i], n);
+			chanlen += n;
+			if (k > 0) {
+				if (keylen > 0)
+					keys[keylen++] = ',';
+				memcpy(keys + keylen, _ircchankeys[i], k);
+				keylen += k;
+			}
+			count++;
+			chanState[i] = IRC_CHAN_JOINING;  // Counts toward CHANLIMIT for the next one
+		}
+	}
+	if (count > 0) {
+		lineAppend("JOIN ");
+		lineAppend(chans, chanlen);
+		if (keylen > 0) {
+			lineAppend(' ');
+			lineAppend(keys, keylen);
+		}
+		lineEnd();
+	}
+}
+
+/* Registration goes out as soon as TCP is up, all in one write (loop() holds the lines until it
+ * returns); no need to wait for the server to speak first.
+ */
+void IrcBotBase::sendRegistration(void)
+{
+	cap_available = cap_enabled = 0;
+	cap_negotiating = (cap_wanted != 0);
+	sasl_status = IRC_SASL_IDLE;
+	if (cap_negotiating) {
+		// Server holds registration until CAP END; one without CAP support just ignores this
+		lineAppend("CAP LS 302");
+		lineEndPriority();
+	}
+	if (_ircpass[0] != '\0') {
+		lineAppend("PASS ");
+		lineAppend(_ircpass);
+		lineEndPriority();
+	}
+	// Every registration asks for the configured nick again, whatever alternate we ended up with last time
+	strcpy(_ircnick, _ircwantnick);
+	lineAppend("NICK ");
+	lineAppend(_ircnick);
+	lineEndPriority();
+	lineAppend("USER ");
+	lineAppend(_ircuser);
+	lineAppend(" 0 * :");
+	lineAppend(_ircdescription);
+	lineEndPriority();
+	nick_attempts = 0;
+	nick_baselen = strlen(_ircwantnick);
+	if (IRC_LOGGING(IRC_LOG_INFO)) {
+		Dbg->print(">> Registering nick ("); Dbg->print(_ircnick); Dbg->println(") & user-");
 	}
 }
 
-void IrcBot::begin(void)
+void IrcBotBase::begin(void)
 {
 	_enabled = true;
 	botState = IRC_DISCONNECTED;
+	// First attempt goes out right away
+	reconnect_attempts = 0;
+	reconnect_delay = 0;
 	loop();
 }
 
-void IrcBot::end(void)
+/* Pick the wait before the next connect attempt (see IrcReconnectPolicy) */
+void IrcBotBase::scheduleReconnect(void)
+{
+	uint32_t delay, now = millis();
+	unsigned int i;
+
+	if (registered_millis != 0 && now - registered_millis >= reconnectPolicy.stableTime)
+		reconnect_attempts = 0;  // Last connection was a good one; start over
+	registered_millis = 0;
+	reconnect_attempts++;
+
+	delay = reconnectPolicy.initialDelay;
+	for (i=1; i < reconnect_attempts && delay < reconnectPolicy.maxDelay; i++)
+		delay *= 2;
+	if (delay > reconnectPolicy.maxDelay)
+		delay = reconnectPolicy.maxDelay;
+	if (reconnectPolicy.jitterPercent && delay > 0)
+		delay -= ircRandom() % (delay / 100 * reconnectPolicy.jitterPercent + 1);
+
+	throttle_millis = now;
+	reconnect_delay = delay;
+	if (IRC_LOGGING(IRC_LOG_INFO)) {
+		Dbg->print("Reconnect attempt "); Dbg->print(reconnect_attempts);
+		Dbg->print(" in "); Dbg->print(delay); Dbg->println(" ms");
+	}
+	if (reconnectCallback != NULL)
+		reconnectCallback(reconnectCallbackUserobj, reconnect_attempts, delay);
+}
+
+// xorshift32; only used to spread out reconnects
+uint32_t IrcBotBase::ircRandom(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+void IrcBotBase::setReconnectPolicy(const IrcReconnectPolicy *policy)
+{
+	reconnectPolicy = *policy;
+	if (reconnectPolicy.initialDelay == 0)
+		reconnectPolicy.initialDelay = 1;
+	if (reconnectPolicy.jitterPercent > 100)
+		reconnectPolicy.jitterPercent = 100;
+}
+
+void IrcBotBase::end(void)
 {
 	if (conn.connected()) {
-		writebuf("QUIT :Bot quitting via end()\r\n");
+		egressDrain(true);  // Anything still queued goes out ahead of the QUIT
+		lineAppend("QUIT :Bot quitting via end()");
+		lineEndPriority();
+		egressFlush();
 		delay(250);
 		conn.stop();
 		executeOnDisconnectCallback();
@@ -233,7 +865,7 @@ void IrcBot::end(void)
 	_enabled = false;
 }
 
-int IrcBot::getState(void)
+int IrcBotBase::getState(void)
 {
 	return botState;
 }
@@ -241,35 +873,33 @@ int IrcBot::getState(void)
 const char *ircServerStateDescriptions[] = {
 	"Not connected",
 	"Attempting to connect",
-	"Connected; waiting for server response",
-	"Connected; server has shown signs of life",
-	"Registering Nick",
-	"Nick registered",
-	"Registering User & Description",
-	"User & Description Registered; waiting for end of MOTD",
+	"Connected; registering Nick & User",
+	"Registered; waiting for end of MOTD",
 	"IRC connection healthy"
 };
 
-const char *IrcBot::getStateStrerror(void)
+const char *IrcBotBase::getStateStrerror(void)
 {
 	if (!_enabled)
 		return "Bot Disabled";
 	return ircServerStateDescriptions[botState];
 }
 
-void IrcBot::setServer(const char *server)
+void IrcBotBase::setServer(const char *server)
 {
 	if (botState > IRC_DISCONNECTED && strncmp(server, _ircserver, IRC_SERVERNAME_MAXLEN-1) != 0) {
 		// Force re-connect if we're changing servers
 		end();
 		strncpy(_ircserver, server, IRC_SERVERNAME_MAXLEN-1);
+		dns_valid = false;
 		begin();
 	} else {
 		strncpy(_ircserver, server, IRC_SERVERNAME_MAXLEN-1);
+		dns_valid = false;
 	}
 }
 
-void IrcBot::setPort(uint16_t ircPort)
+void IrcBotBase::setPort(uint16_t ircPort)
 {
 	if (botState > IRC_DISCONNECTED && _ircport != ircPort) {
 		// Force re-connect if we're changing ports on the fly
@@ -281,60 +911,130 @@ void IrcBot::setPort(uint16_t ircPort)
 	}
 }
 
-void IrcBot::setNick(const char *nick)
+// Once registered, _ircnick follows the server's NICK reply; until then it's set at registration.
+void IrcBotBase::setNick(const char *nick)
 {
-	strncpy(_ircnick, nick, IRC_NICKUSER_MAXLEN-1);
-	if (botState > IRC_NICK_REGISTERED) {
-		char buf[IRC_NICKUSER_MAXLEN+7];
-		strcpy(buf, "NICK ");
-		strcat(buf, _ircnick);
-		strcat(buf, "\r\n");
-		writebuf(buf);
+	strncpy(_ircwantnick, nick, IRC_NICKUSER_MAXLEN-1);
+	if (botState >= IRC_REGISTERED) {
+		lineAppend("NICK ");
+		lineAppend(_ircwantnick);
+		lineEndPriority();
 	}
 }
 
-void IrcBot::setUsername(const char *user)
+void IrcBotBase::setUsername(const char *user)
 {
 	strncpy(_ircuser, user, IRC_NICKUSER_MAXLEN-1);
 }
 
-void IrcBot::setDescription(const char *desc)
+void IrcBotBase::setDescription(const char *desc)
 {
 	strncpy(_ircdescription, desc, IRC_DESCRIPTION_MAXLEN-1);
 }
 
-void IrcBot::setDebug(Stream *debugStream)
+void IrcBotBase::setPassword(const char *pass)
+{
+	if (pass == NULL)
+		pass = "";
+	strncpy(_ircpass, pass, IRC_PASSWORD_MAXLEN-1);
+}
+
+void IrcBotBase::setCapabilities(uint16_t caps)
+{
+	cap_wanted = (caps & ~IRC_CAP_SASL) | (sasl_mech != IRC_SASL_NONE ? IRC_CAP_SASL : 0);
+}
+
+void IrcBotBase::setSasl(uint8_t mech, const char *account, const char *password)
+{
+	sasl_mech = mech;
+	_saslacct[0] = '\0';
+	_saslpass[0] = '\0';
+	if (account != NULL)
+		strncpy(_saslacct, account, IRC_SASL_ACCOUNT_MAXLEN-1);
+	if (password != NULL)
+		strncpy(_saslpass, password, IRC_PASSWORD_MAXLEN-1);
+	if (mech != IRC_SASL_NONE)
+		cap_wanted |= IRC_CAP_SASL;
+	else
+		cap_wanted &= ~IRC_CAP_SASL;
+}
+
+uint8_t IrcBotBase::getSaslStatus(void)
+{
+	return sasl_status;
+}
+
+uint16_t IrcBotBase::getCapabilities(void)
+{
+	return cap_enabled;
+}
+
+void IrcBotBase::setDebug(Stream *debugStream)
+{
+	Dbg = debugStream;
+}
+
+void IrcBotBase::setLogLevel(uint8_t level)
+{
+	_loglevel = level;
+}
+
+void IrcBotBase::setFloodControl(unsigned int burstLines, unsigned int msPerLine, unsigned int bytesPerSec)
+{
+	flood_burst = burstLines ? burstLines : 1;
+	flood_msperline = msPerLine;
+	flood_bytespersec = bytesPerSec;
+	flood_linetokens = flood_burst * flood_msperline;
+	flood_bytetokens = (flood_bytespersec > IRC_EGRESS_LINE_MAX ? flood_bytespersec : IRC_EGRESS_LINE_MAX) * 1000UL;
+	flood_millis = millis();
+}
+
+void IrcBotBase::setFloodFairness(boolean enable)
+{
+	flood_fair = enable;
+}
+
+unsigned int IrcBotBase::getQueueDepth(void)
+{
+	return txq_pending;
+}
+
+uint32_t IrcBotBase::getQueueDrops(void)
 {
-	if (debugStream != NULL)
-		Dbg = debugStream;
+	return txq_drops;
 }
 
-int IrcBot::addChannel(const char *chan)
+int IrcBotBase::addChannel(const char *chan, const char *key)
 {
-	int i, j = 0;
+	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
+	if (chan == NULL || chan[0] == '\0')
+		return -1;
+	i = channelLookup(chan);
+	if (i >= 0)
+		return i;  // Already have it
+	for (i=0; i < chan_max; i++) {
 		if (_ircchannels[i][0] == '\0') {
 			strncpy(_ircchannels[i], chan, IRC_CHANNEL_MAXLEN-1);
+			strncpy(_ircchankeys[i], key != NULL ? key : "", IRC_CHANKEY_MAXLEN-1);
 			chanState[i] = IRC_CHAN_NOTJOINED;
+			channelIndexAdd(i);
 			return i;
 		}
 	}
 	return -1;
 }
 
-int IrcBot::removeChannel(const int chanidx)
+int IrcBotBase::removeChannel(const int chanidx)
 {
-	if (chanidx < 0 || chanidx >= IRC_CHANNEL_MAX)
+	if (chanidx < 0 || chanidx >= chan_max)
 		return -1;  // Invalid channel index
 	
 	if (chanState[chanidx] == IRC_CHAN_JOINED && conn.connected()) {
 		// Part channel first
-		char buf[IRC_CHANNEL_MAXLEN+7];
-		strcpy(buf, "PART ");
-		strcat(buf, _ircchannels[chanidx]);
-		strcat(buf, "\r\n");
-		writebuf(buf);
+		lineAppend("PART ");
+		lineAppend(_ircchannels[chanidx]);
+		lineEnd();
 	}
 
 	// Flush callback entries related to this channel
@@ -350,25 +1050,27 @@ int IrcBot::removeChannel(const int chanidx)
 	}
 
 	// Deactivate channel slot
+	memberClearChannel(chanidx);
+	if (_ircchannels[chanidx][0] != '\0')
+		channelIndexRemove(chanidx);
 	chanState[chanidx] = IRC_CHAN_NOTJOINED;
 	_ircchannels[chanidx][0] = '\0';
+	_ircchankeys[chanidx][0] = '\0';
 	return chanidx;
 }
 
 // Search for channel by name and part/remove it
-int IrcBot::removeChannel(const char *chan)
+int IrcBotBase::removeChannel(const char *chan)
 {
 	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (strncmp(chan, _ircchannels[i], IRC_CHANNEL_MAXLEN-1) == 0) {
-			return removeChannel(i);
-		}
-	}
-	return -1;  // Channel not found
+	i = channelLookup(chan);
+	if (i < 0)
+		return -1;  // Channel not found
+	return removeChannel(i);
 }
 
-boolean IrcBot::isConnected(void)
+boolean IrcBotBase::isConnected(void)
 {
 	if (botState > IRC_CONNECTING && conn.connected()) {
 		return true;
@@ -376,601 +1078,2075 @@ boolean IrcBot::isConnected(void)
 	return false;
 }
 
-boolean IrcBot::sendPrivmsg(const char *chan, const char *tonick, const char *message)
+boolean IrcBotBase::sendPrivmsg(const char *chan, const char *tonick, const char *message)
 {
 	int i;
 
 	if (botState != IRC_MOTD_FINISHED) {
-		Dbg->println(">> sendPrivmsg: botState != IRC_MOTD_FINISHED");
+		if (IRC_LOGGING(IRC_LOG_WARN))
+			Dbg->println(">> sendPrivmsg: botState != IRC_MOTD_FINISHED");
 		return false;
 	}
 	
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (!strncmp(chan, _ircchannels[i], IRC_CHANNEL_MAXLEN))
-			break;
-	}
-	if (i == IRC_CHANNEL_MAX) {
-		Dbg->print(">> sendPrivmsg: Cannot find channel "); Dbg->print(chan);
-		Dbg->println(" in bot registry.");
+	i = channelLookup(chan);
+	if (i < 0) {
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> sendPrivmsg: Cannot find channel "); Dbg->print(chan);
+			Dbg->println(" in bot registry.");
+		}
 		return false;  // Channel not found in bot registry
 	}
 	if (chanState[i] != IRC_CHAN_JOINED) {
-		Dbg->print(">> sendPrivmsg: Channel "); Dbg->print(chan);
-		Dbg->print(" currently not listed as joined; status=");
-		Dbg->println(chanState[i]);
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> sendPrivmsg: Channel "); Dbg->print(chan);
+			Dbg->print(" currently not listed as joined; status=");
+			Dbg->println(chanState[i]);
+		}
 		return false;  // We haven't yet joined this channel!
 	}
 	
 	// All set; send message
-	Dbg->print(">> sendPrivmsg - Sending message PRIVMSG "); Dbg->print(_ircchannels[i]); Dbg->print(" :");
-	writebuf("PRIVMSG ");
-	writebuf(_ircchannels[i]);
-	writebuf(" :");
-	if (tonick != NULL) {
-		Dbg->print(tonick); Dbg->print(": ");
-		writebuf(tonick);
-		writebuf(": ");
-	}
-	Dbg->println(message);
-	writebuf(message);
-	writebuf("\r\n");
-	return true;
+	if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+		Dbg->print(">> sendPrivmsg - Sending message PRIVMSG "); Dbg->print(_ircchannels[i]); Dbg->print(" :");
+		if (tonick != NULL) {
+			Dbg->print(tonick); Dbg->print(": ");
+		}
+		Dbg->println(message);
+	}
+	return sendSplit("PRIVMSG ", _ircchannels[i], tonick, ": ", message, false);
 }
 
-boolean IrcBot::sendPrivmsgCtcp(const char *chan, const char *ctcpcmd, const char *message)
+boolean IrcBotBase::sendPrivmsgCtcp(const char *chan, const char *ctcpcmd, const char *message)
 {
 	int i;
 
 	if (botState != IRC_MOTD_FINISHED) {
-		Dbg->println(">> sendPrivmsg: botState != IRC_MOTD_FINISHED");
+		if (IRC_LOGGING(IRC_LOG_WARN))
+			Dbg->println(">> sendPrivmsg: botState != IRC_MOTD_FINISHED");
 		return false;
 	}
 	
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (!strncmp(chan, _ircchannels[i], IRC_CHANNEL_MAXLEN))
-			break;
-	}
-	if (i == IRC_CHANNEL_MAX) {
-		Dbg->print(">> sendPrivmsg: Cannot find channel "); Dbg->print(chan);
-		Dbg->println(" in bot registry.");
+	i = channelLookup(chan);
+	if (i < 0) {
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> sendPrivmsg: Cannot find channel "); Dbg->print(chan);
+			Dbg->println(" in bot registry.");
+		}
 		return false;  // Channel not found in bot registry
 	}
 	if (chanState[i] != IRC_CHAN_JOINED) {
-		Dbg->print(">> sendPrivmsg: Channel "); Dbg->print(chan);
-		Dbg->print(" currently not listed as joined; status=");
-		Dbg->println(chanState[i]);
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> sendPrivmsg: Channel "); Dbg->print(chan);
+			Dbg->print(" currently not listed as joined; status=");
+			Dbg->println(chanState[i]);
+		}
 		return false;  // We haven't yet joined this channel!
 	}
 	
 	// All set; send message
-	Dbg->print(">> sendPrivmsgCtcp - Sending CTCP message "); Dbg->print(_ircchannels[i]); Dbg->print(" :");
-	writebuf("PRIVMSG ");
-	writebuf(_ircchannels[i]);
-	writebuf(" :\001");
-	writebuf(ctcpcmd);
-	writebuf(' ');
-	Dbg->print(ctcpcmd); Dbg->print(' ');
-	Dbg->println(message);
-	writebuf(message);
-	writebuf('\001');
-	writebuf("\r\n");
-	return true;
+	if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+		Dbg->print(">> sendPrivmsgCtcp - Sending CTCP message "); Dbg->print(_ircchannels[i]); Dbg->print(" :");
+		Dbg->print(ctcpcmd); Dbg->print(' ');
+		Dbg->println(message);
+	}
+	return sendSplit("PRIVMSG ", _ircchannels[i], ctcpcmd, " ", message, true);
 }
 
-boolean IrcBot::sendPrivmsgUser(const char *user, const char *message)
+boolean IrcBotBase::sendPrivmsgUser(const char *user, const char *message)
 {
-	int i;
-
 	if (botState != IRC_MOTD_FINISHED) {
-		Dbg->println(">> sendPrivmsgUser: botState != IRC_MOTD_FINISHED");
+		if (IRC_LOGGING(IRC_LOG_WARN))
+			Dbg->println(">> sendPrivmsgUser: botState != IRC_MOTD_FINISHED");
 		return false;
 	}
 
 	// All set; send message
-	Dbg->print(">> sendPrivmsgUser - Sending message PRIVMSG "); Dbg->print(user); Dbg->print(" :");
-	writebuf("PRIVMSG ");
-	writebuf(user);
-	writebuf(" :");
-	Dbg->println(message);
-	writebuf(message);
-	writebuf("\r\n");
-	return true;
-}
-
-inline unsigned int IrcBot::ringBufferLen(void)
-{
-	if (ringbuf_start > ringbuf_end)
-		return (IRC_INGRESS_RINGBUF_LEN-ringbuf_start)+ringbuf_end;
-	return ringbuf_end - ringbuf_start;
+	if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+		Dbg->print(">> sendPrivmsgUser - Sending message PRIVMSG "); Dbg->print(user); Dbg->print(" :");
+		Dbg->println(message);
+	}
+	return sendSplit("PRIVMSG ", user, NULL, NULL, message, false);
 }
 
-int IrcBot::ringBufferSearch(const uint8_t search)
+/* The target list is only grown while the whole message still fits on one line (or, for text too long
+ * for that anyway, up to a quarter of the line), so fewer recipients per line never costs extra lines.
+ */
+boolean IrcBotBase::sendPrivmsgMulti(const char *targets[], unsigned int count, const char *message)
 {
-	int i;
-	unsigned int end;
-	uint8_t c;
+	char list[IRC_EGRESS_LINE_MAX];
+	unsigned int listlen = 0, batch = 0, max = targetMax(IRC_CMDTOKEN_PRIVMSG), room, n, i;
+	boolean ok = true;
 
-	if (ringbuf_end < ringbuf_start)
-		end = IRC_INGRESS_RINGBUF_LEN + ringbuf_end;
-	else
-		end = ringbuf_end;
+	if (botState != IRC_MOTD_FINISHED) {
+		if (IRC_LOGGING(IRC_LOG_WARN))
+			Dbg->println(">> sendPrivmsgMulti: botState != IRC_MOTD_FINISHED");
+		return false;
+	}
 
-	for (i = ringbuf_start; i < end; i++) {
-		c = ringbuf[i % IRC_INGRESS_RINGBUF_LEN];
-		if (c == search) {
-			return i - ringbuf_start;
+	// Line room for the target list: our relayed prefix, "PRIVMSG ", " :", the text and "\r\n"
+	n = 1 + (self_prefixlen ? self_prefixlen : strlen(_ircnick) + 2 + strlen(_ircuser) + 1 + IRC_HOSTNAME_MAXLEN) + 1 + 8 + 2 + 2;
+	room = strlen(message);
+	room = (n + room < isupport.linelen) ? isupport.linelen - n - room : isupport.linelen / 4;
+
+	for (i=0; i < count; i++) {
+		n = strlen(targets[i]);
+		if (batch > 0 && (batch == max || listlen + 1 + n > room)) {
+			list[listlen] = '\0';
+			ok = sendSplit("PRIVMSG ", list, NULL, NULL, message, false) && ok;
+			listlen = batch = 0;
 		}
+		if (n >= sizeof(list) / 2)
+			continue;  // Not a real target
+		if (batch > 0)
+			list[listlen++] = ',';
+		memcpy(list + listlen, targets[i], n);
+		listlen += n;
+		batch++;
+	}
+	if (batch > 0) {
+		list[listlen] = '\0';
+		ok = sendSplit("PRIVMSG ", list, NULL, NULL, message, false) && ok;
 	}
-	return -1;  // Not found
+	return ok;
 }
 
-unsigned int IrcBot::ringBufferSearchConsume(void *buf, const uint8_t search)
+/* Send "<verb><target> :[\001][<lead><leadsep>]<message>[\001]", split across as many lines as it
+ * takes for each to fit once the server puts our prefix in front of it for everyone else.  Splits fall
+ * on the last space that fits, or failing that between UTF-8 characters, and at any CR/LF in message.
+ * Each piece goes out straight from message; returns false if any line had to be dropped.  A message
+ * with no text (other than a CTCP, which stands on its own) sends nothing, since the server would
+ * only answer ERR_NOTEXTTOSEND.
+ */
+boolean IrcBotBase::sendSplit(const char *verb, const char *target, const char *lead, const char *leadsep, const char *message, boolean ctcp)
 {
-	int i, origin = ringbuf_start;
-	unsigned int end, count = 0;
-	uint8_t c, *cbuf = (uint8_t *)buf;
+	unsigned int fixed, budget, len, n, cut;
+	boolean ok = true;
 
-	if (ringbuf_end < ringbuf_start)
-		end = IRC_INGRESS_RINGBUF_LEN + ringbuf_end;
-	else
-		end = ringbuf_end;
+	while (*message == '\r' || *message == '\n')
+		message++;
+	if (*message == '\0' && !ctcp)
+		return true;
 
-	for (i = ringbuf_start; i < end; i++) {
-		c = ringbuf[i % IRC_INGRESS_RINGBUF_LEN];
-		if (c != search) {
-			cbuf[i-origin] = c;
-			ringbuf_start++;
-			count++;
-		} else {
-			break;
+	// ":nick!user@host " + verb + target + " :" + lead/leadsep/CTCP wrapping + "\r\n"
+	fixed = 1 + (self_prefixlen ? self_prefixlen : strlen(_ircnick) + 2 + strlen(_ircuser) + 1 + IRC_HOSTNAME_MAXLEN) + 1;
+	fixed += strlen(verb) + strlen(target) + 2 + 2;
+	if (lead != NULL)
+		fixed += strlen(lead) + strlen(leadsep);
+	if (ctcp)
+		fixed += 2;
+	if (fixed + 16 > isupport.linelen) {
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> sendSplit: no room for a message to "); Dbg->println(target);
 		}
+		return false;
 	}
-	ringbuf_start = ringbuf_start % IRC_INGRESS_RINGBUF_LEN;
-	Dbg->println();
-	return count;
+	budget = isupport.linelen - fixed;
+
+	do {
+		len = strcspn(message, "\r\n");
+		n = len;
+		if (n > budget) {
+			n = budget;
+			for (cut = n; cut > budget/2 && message[cut] != ' '; cut--)
+				;
+			if (message[cut] == ' ') {
+				n = cut;
+			} else {
+				while (n > 0 && ((uint8_t)message[n] & 0xC0) == 0x80)
+					n--;  // Don't cut a multibyte character in two
+				if (n == 0)
+					n = budget;  // Not UTF-8 after all
+			}
+		}
+
+		lineAppend(verb);
+		lineAppend(target);
+		lineAppend(" :");
+		if (ctcp)
+			lineAppend('\001');
+		if (lead != NULL) {
+			lineAppend(lead);
+			lineAppend(leadsep);
+		}
+		lineAppend(message, n);
+		if (ctcp)
+			lineAppend('\001');
+		ok = lineEnd(target) && ok;
+
+		message += n;
+		if (*message == ' ' && n < len)
+			message++;  // The space we split at
+		while (*message == '\r' || *message == '\n')
+			message++;
+	} while (*message != '\0');
+	return ok;
+}
+
+inline unsigned int IrcBotBase::ringBufferLen(void)
+{
+	if (ringbuf_start > ringbuf_end)
+		return (ringbuf_size-ringbuf_start)+ringbuf_end;
+	return ringbuf_end - ringbuf_start;
+}
+
+/* Delimiter scanner - returns the offset of the first byte in buf[0..len) equal to a or b, or len if
+ * neither is present.  Pass the same byte twice to search for a single delimiter.
+ * Whole words or vectors are compared at a time: SSE2 or NEON where the host has them, otherwise a
+ * 32-bit SWAR "has zero byte" test (Cortex-M), finishing the tail a byte at a time.
+ */
+unsigned int ircScanDelim(const uint8_t *buf, unsigned int len, const uint8_t a, const uint8_t b)
+{
+	unsigned int i = 0;
+
+#if defined(__SSE2__)
+	const __m128i va = _mm_set1_epi8((char)a), vb = _mm_set1_epi8((char)b);
+	__m128i v;
+	int mask;
+
+	for (; i + 16 <= len; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(buf + i));
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#elif defined(__ARM_NEON)
+	const uint8x16_t va = vdupq_n_u8(a), vb = vdupq_n_u8(b);
+	uint8x16_t v;
+	uint64_t mask;
+
+	for (; i + 16 <= len; i += 16) {
+		v = vld1q_u8(buf + i);
+		v = vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb));
+		// Narrow each 8-bit lane result to a nibble so the whole compare fits in one 64-bit word
+		mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+		if (mask)
+			return i + (__builtin_ctzll(mask) >> 2);
+	}
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	const uint32_t wa = 0x01010101UL * a, wb = 0x01010101UL * b;
+	uint32_t w, xa, xb, hit;
+
+	for (; i + 4 <= len; i += 4) {
+		memcpy(&w, buf + i, 4);  // Compiles to a single (unaligned-capable) word load
+		xa = w ^ wa;
+		xb = w ^ wb;
+		// High bit set in each byte lane that was zero, i.e. matched; the lowest flagged lane is exact.
+		hit = ((xa - 0x01010101UL) & ~xa) | ((xb - 0x01010101UL) & ~xb);
+		hit &= 0x80808080UL;
+		if (hit)
+			return i + (__builtin_ctz(hit) >> 3);
+	}
+#endif
+
+	for (; i < len; i++) {
+		if (buf[i] == a || buf[i] == b)
+			return i;
+	}
+	return len;
+}
+
+// One slot is always left empty so a full ring can't be mistaken for an empty one.
+inline unsigned int IrcBotBase::ringBufferFree(void)
+{
+	return ringbuf_size - 1 - ringBufferLen();
+}
+
+/* Read from the TCP connection straight into the free region of the ring buffer.  The free space
+ * is at most two contiguous spans (up to the end of the array, then from the front); each read is
+ * capped to the span so data which hasn't been processed yet is never overwritten.  Once the ring is
+ * full, reading stops and the rest stays in the connection until lines have been consumed.
+ */
+int IrcBotBase::ringBufferFill(void)
+{
+	unsigned int room, span;
+	int len, total = 0;
+
+	room = ringBufferFree();
+	while (room > 0) {
+		span = room;
+		if (ringbuf_end + span > ringbuf_size)
+			span = ringbuf_size - ringbuf_end;
+		len = conn.read(&ringbuf[ringbuf_end], span);
+		if (len <= 0)
+			break;
+		ringbuf_end = (ringbuf_end + len) % ringbuf_size;
+		total += len;
+		room -= len;
+		if ((unsigned int)len < span)
+			break;  // Connection has nothing more for us right now
+	}
+	if (total > 0) {
+		ingress.bytesRead += total;
+		if (room == 0)
+			ingress.fullReads++;
+		if (ringBufferLen() > ingress.peakLen)
+			ingress.peakLen = ringBufferLen();
+	}
+	return total;
+}
+
+void IrcBotBase::ringBufferReset(void)
+{
+	ringbuf_start = ringbuf_end = 0;
+	ringbuf_scan = 0;
+	ringbuf_skiplf = false;
+	ringbuf_discard = false;
+}
+
+/* Line framing - locate the end of the line sitting at ringbuf_start.
+ * ringbuf_scan remembers how many bytes past ringbuf_start have already been checked, so a partial
+ * line left in the buffer across several loop() calls is only ever scanned once.  Either \r or \n
+ * terminates a line; the \n of a \r\n pair is swallowed even when it arrives in a later read.
+ * A line which grows past IRC_INGRESS_LINE_MAX is dropped as it arrives, so the ring never fills up
+ * with it; everything up to its terminator is skipped and framing picks up again at the next line.
+ * Returns the length of the line (excluding its terminator) or -1 if no complete line is available yet.
+ */
+int IrcBotBase::ringBufferFrameLine(void)
+{
+	unsigned int len, pos, span, found;
+
+	while (1) {
+		if (ringbuf_skiplf && ringbuf_start != ringbuf_end) {
+			if (ringbuf[ringbuf_start] == '\n')
+				ringBufferFlush(1);
+			ringbuf_skiplf = false;
+		}
+
+		// The unscanned data occupies at most two contiguous spans of the ring; search each in bulk.
+		len = ringBufferLen();
+		found = span = 0;
+		while (ringbuf_scan < len) {
+			pos = (ringbuf_start + ringbuf_scan) % ringbuf_size;
+			span = len - ringbuf_scan;
+			if (pos + span > ringbuf_size)
+				span = ringbuf_size - pos;
+			found = ircScanDelim(&ringbuf[pos], span, '\r', '\n');
+			ringbuf_scan += found;
+			if (found < span)
+				break;
+		}
+
+		if (found == span) {  // Not found
+			if (!ringbuf_discard && ringbuf_scan > IRC_INGRESS_LINE_MAX) {
+				ringbuf_discard = true;
+				ingress.oversizedLines++;
+				if (IRC_LOGGING(IRC_LOG_WARN))
+					Dbg->println(">> Line too long to process; discarding");
+			}
+			if (ringbuf_discard) {
+				ingress.bytesDiscarded += ringBufferFlush(ringbuf_scan);
+				ringbuf_scan = 0;
+			}
+			return -1;
+		}
+		if (!ringbuf_discard && ringbuf_scan <= IRC_INGRESS_LINE_MAX)
+			return ringbuf_scan;
+
+		// The end of an oversized line (or all of one that arrived in a single read); drop it and resync
+		if (!ringbuf_discard) {
+			ingress.oversizedLines++;
+			if (IRC_LOGGING(IRC_LOG_WARN))
+				Dbg->println(">> Line too long to process; discarded");
+		}
+		ringbuf_discard = false;
+		if (ringbuf[(ringbuf_start + ringbuf_scan) % ringbuf_size] == '\r')
+			ringbuf_skiplf = true;
+		ingress.bytesDiscarded += ringBufferFlush(ringbuf_scan + 1);
+		ringbuf_scan = 0;
+	}
+}
+
+/* Hand out the line framed by ringBufferFrameLine() as a NUL-terminated string which lives in the
+ * ring buffer itself, and consume it along with its terminator.  The terminator is overwritten with
+ * the NUL.  A line which wraps past the end of the array has its head (the bytes at the front of the
+ * array) mirrored into the slack area behind ringbuf_size so it can be read contiguously;
+ * framing never hands out more than IRC_INGRESS_LINE_MAX bytes, so it always fits.
+ * The string stays valid until the next ringBufferFill().
+ */
+char *IrcBotBase::ringBufferLine(const unsigned int linelen)
+{
+	char *line = (char *)&ringbuf[ringbuf_start];
+	unsigned int term = (ringbuf_start + linelen) % ringbuf_size, wrapped;
+
+	if (ringbuf[term] == '\r')
+		ringbuf_skiplf = true;
+
+	if (ringbuf_start + linelen < ringbuf_size) {
+		ringbuf[term] = '\0';
+	} else {
+		wrapped = ringbuf_start + linelen - ringbuf_size;
+		memcpy(&ringbuf[ringbuf_size], &ringbuf[0], wrapped);
+		ringbuf[ringbuf_size + wrapped] = '\0';
+	}
+
+	ringBufferFlush(linelen + 1);
+	ringbuf_scan = 0;
+	ingress.lines++;
+	return line;
+}
+
+unsigned int IrcBotBase::ringBufferFlush(const unsigned int count)
+{
+	unsigned int ttl;
+
+	ttl = ringBufferLen();
+	if (ttl > count)
+		ttl = count;
+
+	ringbuf_start = (ringbuf_start + ttl) % ringbuf_size;
+	return ttl;
+}
+
+/* Split a raw protocol line into an IrcMessage view, in a single pass:
+ *   [:prefix] command [params ...] [:trailing]
+ * Delimiters are overwritten with NULs so every field of msg points into the line; nothing is copied.
+ * A trailing parameter (if any) is also the last entry in params[].
+ */
+boolean IrcBotBase::parseMessage(char *line, IrcMessage *msg)
+{
+	char *p = line, *q;
+	unsigned int len = strlen(line), n;
+
+	memset(msg, 0, sizeof(IrcMessage));
+
+	if (*p == '@') {  // IRCv3 tags: @key[=value][;key[=value]...]
+		p++;
+		n = ircScanDelim((uint8_t *)p, len - (p - line), ' ', ' ');
+		if (p[n] == '\0')
+			return false;  // Tags with no command
+		p[n] = '\0';
+		parseTags(p, n, msg);
+		p += n + 1;
+		while (*p == ' ')
+			p++;
+	}
+
+	if (*p == ':') {  // Prefix: servername or nick[!user][@host]
+		p++;
+		n = ircScanDelim((uint8_t *)p, len - (p - line), ' ', ' ');
+		if (p[n] == '\0')
+			return false;  // Prefix with no command
+		p[n] = '\0';
+		msg->nick = p;
+
+		q = p + ircScanDelim((uint8_t *)p, n, '!', '@');
+		if (*q == '!') {
+			*q++ = '\0';
+			if (*q == '~')
+				q++;
+			msg->user = q;
+			q += ircScanDelim((uint8_t *)q, n - (q - p), '@', '@');
+		}
+		if (*q == '@') {
+			*q++ = '\0';
+			msg->host = q;
+		}
+		p += n + 1;
+	}
+
+	while (*p == ' ')
+		p++;
+	if (*p == '\0')
+		return false;  // No command
+	msg->command = p;
+	n = ircScanDelim((uint8_t *)p, len - (p - line), ' ', ' ');
+	p += n;
+
+	while (*p != '\0') {
+		*p++ = '\0';
+		while (*p == ' ')
+			p++;
+		if (*p == '\0')
+			break;
+		if (*p == ':' || msg->paramc == IRC_MESSAGE_PARAMS_MAX-1) {  // Trailing parameter runs to end-of-line
+			if (*p == ':')
+				p++;
+			msg->trailing = p;
+			msg->params[msg->paramc++] = p;
+			break;
+		}
+		msg->params[msg->paramc++] = p;
+		p += ircScanDelim((uint8_t *)p, len - (p - line), ' ', ' ');
+	}
+
+	msg->cmdtoken = ircProtocolCommandToken(msg->command);
+	return true;
+}
+
+/* Split tags[0..len) in place into msg->tags.  Escaped values (\: \s \\ \r \n) are unescaped in place;
+ * the result is never longer than the original, so it always fits.
+ */
+void IrcBotBase::parseTags(char *tags, unsigned int len, IrcMessage *msg)
+{
+	char *p = tags, *end = tags + len, *v, *in;
+	unsigned int n;
+
+	while (p < end && msg->tagc < IRC_MESSAGE_TAGS_MAX) {
+		n = ircScanDelim((uint8_t *)p, end - p, ';', ';');
+		p[n] = '\0';
+		if (n > 0) {
+			v = p + ircScanDelim((uint8_t *)p, n, '=', '=');
+			if (*v == '=')
+				*v++ = '\0';
+			msg->tags[msg->tagc].key = p;
+			msg->tags[msg->tagc++].value = v;  // Points at the key's NUL (i.e. "") when there's no value
+
+			// Only values containing a backslash need unescaping
+			in = v + ircScanDelim((uint8_t *)v, p + n - v, '\\', '\\');
+			for (v = in; *in != '\0'; in++) {
+				if (*in == '\\') {
+					switch (*++in) {
+						case ':': *v++ = ';'; continue;
+						case 's': *v++ = ' '; continue;
+						case 'r': *v++ = '\r'; continue;
+						case 'n': *v++ = '\n'; continue;
+						case '\0': in--; continue;  // Lone trailing backslash is dropped
+					}
+				}
+				*v++ = *in;
+			}
+			*v = '\0';
+		}
+		p += n + 1;
+	}
+}
+
+const char *ircMessageTag(const IrcMessage *msg, const char *key)
+{
+	int i;
+
+	for (i=0; i < msg->tagc; i++) {
+		if (!strcmp(msg->tags[i].key, key))
+			return msg->tags[i].value;
+	}
+	return NULL;
+}
+
+/* Read and process what the server has sent.  Only as much is read as the ring buffer has room for,
+ * and every complete line is handled in place before reading more, so a long burst (a big channel's
+ * NAMES, say) streams through the fixed buffer instead of overrunning it.  Refills continue while the
+ * connection keeps the ring topped up, up to IRC_INGRESS_PASS_MAX bytes per pass; the rest waits in
+ * the socket for the next loop().
+ */
+void IrcBotBase::processInboundData(void)
+{
+	int len, filled;
+	unsigned int room, total = 0;
+	char *line;
+	IrcMessage msg;
+
+	do {
+		if (IRC_LOGGING(IRC_LOG_TRACE))
+			Dbg->print("issuing read-");
+		room = ringBufferFree();
+		filled = ringBufferFill();
+		if (filled > 0) {
+			total += filled;
+			if (IRC_LOGGING(IRC_LOG_TRACE)) {
+				Dbg->print("Read "); Dbg->print(filled); Dbg->println(" bytes into ring buffer-");
+			}
+		}
+		if (ringBufferLen() == 0 || !_enabled || botState <= IRC_DISCONNECTED)
+			return;
+		if (IRC_LOGGING(IRC_LOG_TRACE)) {
+			Dbg->print("Ring buffer has "); Dbg->print(ringBufferLen()); Dbg->println(" bytes; processing:");
+		}
+		// Process incoming message
+		while ( (len = ringBufferFrameLine()) >= 0 ) {  // A full message is available.
+			line = ringBufferLine(len);
+			if (len == 0)
+				continue;  // Blank line, e.g. between a bare \n and the next message
+
+			if (IRC_LOGGING(IRC_LOG_TRACE)) {
+				Dbg->print("RECV: "); Dbg->println(line);
+			}
+			// line contains our message; process!
+			if (!parseMessage(line, &msg)) {
+				// Malformed line, discard.
+				continue;
+			}
+
+			if (IRC_LOGGING(IRC_LOG_TRACE)) {
+				Dbg->print(">> Command token is "); Dbg->print(ircReplyCodeStrerror(msg.cmdtoken));
+				Dbg->print("; params = "); Dbg->println(msg.paramc);
+				if (msg.user != NULL && msg.host != NULL) {
+					Dbg->print(">> Parsed \"From\": ");
+					Dbg->print("nick="); Dbg->print(msg.nick);
+					Dbg->print(", user="); Dbg->print(msg.user);
+					Dbg->print(", host="); Dbg->println(msg.host);
+				}
+			}
+
+			if (msg.cmdtoken > 0) {
+				// Valid command or reply; process!
+				if (!processMessage(&msg))
+					return;
+			}
+		}
+		// A fill that used all the room it had probably left more behind in the socket
+	} while (filled > 0 && (unsigned int)filled == room && total < IRC_INGRESS_PASS_MAX);
+}
+
+/* Act on one parsed message.  Routing comes from the reply code table: codes flagged
+ * IRC_REPLY_HANDLED are passed to their handler in messageHandlers[], codes flagged IRC_REPLY_FORWARD
+ * are passed on to the OnReply callback.  Returns false if the rest of the ring buffer must be left
+ * alone until the next loop() pass (e.g. the state machine has to re-register first).
+ */
+boolean IrcBotBase::processMessage(IrcMessage *msg)
+{
+	const IrcReplyCode *rc = ircReplyCodeLookup(msg->cmdtoken);
+	uint8_t flags = IRC_REPLY_FORWARD;  // Codes we know nothing about are still of interest to the sketch
+	boolean keep_going = true;
+
+	if (rc != NULL)
+		flags = rc->flags;
+
+	if (flags & IRC_REPLY_HANDLED)
+		keep_going = (this->*messageHandlers[rc->handler])(msg);
+
+	if ((flags & IRC_REPLY_FORWARD) && _enabled && replyCallback != NULL)
+		replyCallback(replyCallbackUserobj, msg);
+
+	return keep_going;
+}
+
+const IrcBotBase::MessageHandler IrcBotBase::messageHandlers[IRC_HANDLER_MAX] = {
+	NULL,
+	&IrcBotBase::handlePing,
+	&IrcBotBase::handlePong,
+	&IrcBotBase::handleEndOfMotd,
+	&IrcBotBase::handleJoinPart,
+	&IrcBotBase::handlePrivmsg,
+	&IrcBotBase::handleNickError,
+	&IrcBotBase::handleWelcome,
+	&IrcBotBase::handleBanned,
+	&IrcBotBase::handleCap,
+	&IrcBotBase::handleSasl,
+	&IrcBotBase::handleISupport,
+	&IrcBotBase::handleMembership
+};
+
+// Received ping, send PONG
+boolean IrcBotBase::handlePing(IrcMessage *msg)
+{
+	lineAppend("PONG :");
+	if (msg->paramc > 0)
+		lineAppend(msg->params[0]);
+	else
+		lineAppend(_ircuser);
+	lineEndPriority();
+	if (IRC_LOGGING(IRC_LOG_DEBUG))
+		Dbg->println(">> Responded with PONG");
+	return true;
+}
+
+// Received PONG from a prior PING
+boolean IrcBotBase::handlePong(IrcMessage *msg)
+{
+	if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+		Dbg->print(">> Received PONG: ");
+		if (msg->paramc > 0)
+			Dbg->println(msg->params[msg->paramc-1]);
+		else
+			Dbg->println(" (no data)");
+	}
+	return true;
+}
+
+boolean IrcBotBase::handleEndOfMotd(IrcMessage *msg)
+{
+	if (botState >= IRC_REGISTERED)
+		botState = IRC_MOTD_FINISHED;
+	_hasmotd = true;
+	registered_millis = millis() | 1;  // Never 0, which means "not registered"
+	// Process event onMotdFinished
+	executeOnMotdFinishedCallback();
+	return true;
+}
+
+boolean IrcBotBase::handleJoinPart(IrcMessage *msg)
+{
+	int i, chanidx;
+	boolean is_from_user = (msg->user != NULL && msg->host != NULL);
+
+	// What's the channel?
+	if (msg->paramc < 1)
+		return true;
+	chanidx = channelLookup(msg->params[0]);
+	if (chanidx >= 0) {
+		// Is this in relation to us?
+		if (is_from_user) {
+			if (caseEqual(msg->nick, _ircnick)) {
+				if (msg->cmdtoken == IRC_CMDTOKEN_JOIN) {
+					// Now we know exactly what prefix the server puts on our messages
+					self_prefixlen = strlen(msg->nick) + 1 + strlen(msg->user) + 1 + strlen(msg->host);
+					memberClearChannel(chanidx);  // NAMES follows with the full list
+					if (chanState[chanidx] == IRC_CHAN_JOINING) {
+						chanState[chanidx] = IRC_CHAN_JOINED;
+						if (IRC_LOGGING(IRC_LOG_INFO)) {
+							Dbg->print(">> Confirmed JOIN for channel "); Dbg->println(_ircchannels[chanidx]);
+						}
+						// Execute channel JOIN callback if registered
+						executeOnChannelJoinCallback(chanidx);
+					}
+				} else {  // IRC_CMDTOKEN_PART
+					chanState[chanidx] = IRC_CHAN_NOTJOINED;
+					memberClearChannel(chanidx);
+					if (IRC_LOGGING(IRC_LOG_INFO)) {
+						Dbg->print(">> We have PARTed channel "); Dbg->println(_ircchannels[chanidx]);
+					}
+					// Execute channel PART callback if registered
+					executeOnChannelPartCallback(chanidx);
+				} /* if(cmdtoken == IRC_CMDTOKEN_JOIN or not) */
+			} else {
+				// No, this is notifying us of someone else joining/parting a channel
+				// See if an appropriate callback has been registered for this one.
+				if (msg->cmdtoken == IRC_CMDTOKEN_JOIN)
+					memberAdd(chanidx, msg->nick, 0);
+				else
+					memberPart(chanidx, msg->nick);
+				if (msg->cmdtoken == IRC_CMDTOKEN_JOIN) {
+					for (i=0; i < usercb_max; i++) {
+						if (channelUserJoinCallbacks[i].chanidx == chanidx &&
+							channelUserJoinCallbacks[i].callback != NULL &&
+							caseEqual(channelUserJoinCallbacks[i].nick, msg->nick)) {
+
+							if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+								Dbg->print(">> Executing OnChannelUserJoin callback for channel ");
+								Dbg->print(_ircchannels[chanidx]); Dbg->print(" and nick=");
+								Dbg->println(channelUserJoinCallbacks[i].nick);
+							}
+							channelUserJoinCallbacks[i].callback(channelUserJoinCallbacks[i].userobj,
+																 _ircchannels[chanidx],
+																 channelUserJoinCallbacks[i].nick);
+						}
+					}
+				} else {  // IRC_CMDTOKEN_PART
+					for (i=0; i < usercb_max; i++) {
+						if (channelUserPartCallbacks[i].chanidx == chanidx &&
+							channelUserPartCallbacks[i].callback != NULL &&
+							caseEqual(channelUserPartCallbacks[i].nick, msg->nick)) {
+
+							if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+								Dbg->print(">> Executing OnChannelUserPart callback for channel ");
+								Dbg->print(_ircchannels[chanidx]); Dbg->print(" and nick=");
+								Dbg->println(channelUserPartCallbacks[i].nick);
+							}
+							channelUserPartCallbacks[i].callback(channelUserPartCallbacks[i].userobj,
+																 _ircchannels[chanidx],
+																 channelUserPartCallbacks[i].nick);
+						}
+					}
+				} /* if(cmdtoken == IRC_CMDTOKEN_JOIN or not) */
+			}
+		}
+	} else {
+		// A message from an invalid channel?  Odd...
+		if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+			if (msg->cmdtoken == IRC_CMDTOKEN_JOIN)
+				Dbg->print(">> Received a JOIN message for a channel we don't have in our registry! (");
+			else
+				Dbg->print(">> Received a PART message for a channel we don't have in our registry! (");
+			Dbg->print(msg->params[0]);
+			Dbg->println(")");
+		}
+	}
+	return true;
+}
+
+boolean IrcBotBase::handlePrivmsg(IrcMessage *msg)
+{
+	int i, j;
+	const char *tochan, *tmp2;
+	char *tonick = NULL, *tmp1 = NULL, *msgstart = NULL;
+	boolean is_from_user = (msg->user != NULL && msg->host != NULL), found_cmd, found_authnick;
+
+	if (msg->paramc < 2) {
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->println(">> Malformed PRIVMSG; missing target or message");
+		}
+		return true;  // Malformed PRIVMSG line
+	}
+	if ((cap_enabled & IRC_CAP_ECHO_MESSAGE) && msg->nick != NULL && caseEqual(msg->nick, _ircnick))
+		return true;  // Our own message coming back (echo-message)
+	tochan = msg->params[0];
+	tonick = msg->params[1];
+	// A message of the form "nick: text" is directed at that nick
+	tmp1 = tonick + ircScanDelim((uint8_t *)tonick, strlen(tonick), ':', ' ');
+	if (*tmp1 == ':') {
+		*tmp1 = '\0';
+		do {
+			tmp1++;
+		} while (*tmp1 == ' ');
+		msgstart = tmp1;
+	} else {
+		msgstart = tonick;
+		tonick = NULL;
+	}
+
+	/* At this point, chan = NUL-terminated channel name, tonick = NUL-terminated target nickname if present or NULL if not,
+	 * and msgstart points to the real message.
+	 */
+	if (IRC_LOGGING(IRC_LOG_TRACE)) {
+		Dbg->print(">> Privmsg CHAN="); Dbg->print(tochan); Dbg->print(", ToNick=");
+		if (tonick != NULL)
+			Dbg->print(tonick);
+		else
+			Dbg->print("(none applicable)");
+		Dbg->print(", Message=");
+		Dbg->println(msgstart);
+	}
+
+	if (is_from_user && tonick != NULL && caseEqual(tonick, _ircnick)) {
+		if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+			Dbg->println(">> Message directed to us; running command processing subsystem");
+		}
+		// Message directed to us; search command registry and send to callback!
+		tmp1 = msgstart + ircScanDelim((uint8_t *)msgstart, strlen(msgstart), ' ', ' ');
+		if (*tmp1 != '\0') {
+			*tmp1 = '\0';
+			tmp1++;
+		} else {
+			tmp1 = NULL;
+		}
+		found_cmd = false;
+		i = commandLookup(msgstart);
+		if (i >= 0) {  // Found a match; execute!
+			found_cmd = true;
+			// Handle authnicks authentication
+			if (commandCallbackRegistry[i].authnicks == NULL) {
+				if (IRC_LOGGING(IRC_LOG_DEBUG))
+					Dbg->println(">> Executing callback");
+				commandCallbackRegistry[i].callback(commandCallbackRegistry[i].userobj,
+													tochan,
+													msg->nick,
+													tmp1);
+			} else {
+				// Source nick is in msg->nick
+				j = 0;
+				tmp2 = commandCallbackRegistry[i].authnicks[j];
+				found_authnick = false;
+				while (tmp2 != NULL && tmp2[0] != '\0') {
+					if (!strncmp(msg->nick, tmp2, IRC_NICKUSER_MAXLEN)) {
+						// Found msg->nick in authnicks; proceed to execute callback
+						found_authnick = true;
+						if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+							Dbg->println(">> Nick authorized; executing callback");
+						}
+						commandCallbackRegistry[i].callback(commandCallbackRegistry[i].userobj,
+															tochan,
+															msg->nick,
+															tmp1);
+						break;
+					}
+					j++;
+					tmp2 = commandCallbackRegistry[i].authnicks[j];
+				}
+				if (!found_authnick) {
+					if (IRC_LOGGING(IRC_LOG_DEBUG))
+						Dbg->println(">> Nick not found in authnicks list.");
+					if (commandCallbackRegistry[i].unauth_callback != NULL) {
+						if (IRC_LOGGING(IRC_LOG_DEBUG))
+							Dbg->println(">> Executing unauthorized-attempt callback for this command");
+						commandCallbackRegistry[i].unauth_callback(commandCallbackRegistry[i].userobj,
+																   tochan,
+																   msg->nick,
+																   tmp1);
+					}
+				}
+			} /* if (authnicks == NULL) */
+		} /* if (found a matching callback for this command) */
+		if (!found_cmd && unknownCommandCallback != NULL) {
+			if (IRC_LOGGING(IRC_LOG_DEBUG))
+				Dbg->println(">> Executing unknown-command callback routine");
+			unknownCommandCallback(unknownCommandCallbackUserobj, tochan, msg->nick, tmp1);
+		}
+	}
+	return true;
+}
+
+/* Nick in use or refused.  While registering, try an alternate right away - the USER we already sent
+ * still stands, so only a new NICK is needed.  First the requested nick with "_" added, then with 3
+ * random digits.  Once registered the server keeps our old nick, so there's nothing to do.
+ */
+boolean IrcBotBase::handleNickError(IrcMessage *msg)
+{
+	unsigned int pos, n;
+
+	if (IRC_LOGGING(IRC_LOG_WARN)) {
+		Dbg->print(">> Server reported nickname "); Dbg->print(_ircnick); Dbg->println(" in use or invalid!");
+	}
+	if (botState != IRC_REGISTERING)
+		return true;
+
+	if (++nick_attempts > IRC_NICK_RETRY_MAX) {
+		if (IRC_LOGGING(IRC_LOG_ERROR))
+			Dbg->println(">> Out of alternate nicks; dropping the connection");
+		conn.stop();
+		return false;
+	}
+	// Alternates are always built on the configured nick, never on the previous alternate
+	memcpy(_ircnick, _ircwantnick, nick_baselen);
+	pos = nick_baselen;
+	if (nick_attempts == 1 && pos < IRC_NICKUSER_MAXLEN-1) {
+		_ircnick[pos++] = '_';
+	} else {
+		if (pos > IRC_NICKUSER_MAXLEN-4)
+			pos = IRC_NICKUSER_MAXLEN-4;
+		n = ircRandom() % 1000;
+		_ircnick[pos++] = '0' + n / 100;
+		_ircnick[pos++] = '0' + (n / 10) % 10;
+		_ircnick[pos++] = '0' + n % 10;
+	}
+	_ircnick[pos] = '\0';
+
+	lineAppend("NICK ");
+	lineAppend(_ircnick);
+	lineEndPriority();
+	return true;
+}
+
+boolean IrcBotBase::handleWelcome(IrcMessage *msg)
+{
+	cap_negotiating = false;  // Server didn't wait for CAP END; it must not support CAP
+	if (botState == IRC_REGISTERING) {
+		// The server has the final say on our nick (it may have truncated it)
+		if (msg->cmdtoken == IRC_CMDTOKEN_RPL_WELCOME && msg->paramc > 1)
+			strncpy(_ircnick, msg->params[0], IRC_NICKUSER_MAXLEN-1);
+		botState = IRC_REGISTERED;
+		if (_hasmotd)
+			botState = IRC_MOTD_FINISHED;  // Advance past registration completely
+	}
+	return true;
+}
+
+/* IRCv3 capability negotiation */
+static const char *ircCapNames[IRC_CAP_COUNT] = {
+	"server-time",
+	"account-tag",
+	"batch",
+	"echo-message",
+	"message-tags",
+	"sasl"
+};
+
+// IRC_CAP_* bits for the names in a space separated capability list; "-name" entries and values are skipped.
+uint16_t IrcBotBase::ircCapParse(const char *list)
+{
+	unsigned int len = strlen(list), n, namelen, i;
+	uint16_t caps = 0;
+
+	while (len > 0) {
+		n = ircScanDelim((const uint8_t *)list, len, ' ', ' ');
+		namelen = ircScanDelim((const uint8_t *)list, n, '=', '=');
+		if (namelen > 0 && list[0] != '-') {
+			for (i=0; i < IRC_CAP_COUNT; i++) {
+				if (strlen(ircCapNames[i]) == namelen && !strncmp(list, ircCapNames[i], namelen)) {
+					caps |= 1 << i;
+					break;
+				}
+			}
+		}
+		if (n == len)
+			break;
+		list += n + 1;
+		len -= n + 1;
+	}
+	return caps;
+}
+
+void IrcBotBase::sendCapRequest(uint16_t caps)
+{
+	unsigned int i;
+	char sep = ':';
+
+	lineAppend("CAP REQ ");
+	for (i=0; i < IRC_CAP_COUNT; i++) {
+		if (caps & (1 << i)) {
+			lineAppend(sep);
+			lineAppend(ircCapNames[i]);
+			sep = ' ';
+		}
+	}
+	lineEndPriority();
+}
+
+void IrcBotBase::endCapNegotiation(void)
+{
+	if (!cap_negotiating)
+		return;
+	lineAppend("CAP END");
+	lineEndPriority();
+	cap_negotiating = false;
+}
+
+// CAP <target> <subcommand> [*] :<list>; a "*" before the list means more lines of the same reply follow
+boolean IrcBotBase::handleCap(IrcMessage *msg)
+{
+	const char *sub, *list;
+	boolean more;
+	uint16_t caps;
+
+	if (msg->paramc < 3)
+		return true;
+	sub = msg->params[1];
+	list = msg->params[msg->paramc-1];
+	more = (msg->paramc > 3 && !strcmp(msg->params[2], "*"));
+
+	if (!strcmp(sub, "LS")) {
+		cap_available |= ircCapParse(list);
+		if (!more && cap_negotiating) {
+			caps = cap_wanted & cap_available;
+			if (caps)
+				sendCapRequest(caps);
+			else
+				endCapNegotiation();
+		}
+	} else if (!strcmp(sub, "ACK")) {
+		cap_enabled |= ircCapParse(list);
+		if (IRC_LOGGING(IRC_LOG_INFO)) {
+			Dbg->print(">> Capabilities enabled: "); Dbg->println(list);
+		}
+		if (!more && cap_negotiating && (cap_enabled & IRC_CAP_SASL) && sasl_status == IRC_SASL_IDLE) {
+			// Log in first; CAP END goes out once the server reports how that went
+			lineAppend("AUTHENTICATE ");
+			lineAppend(sasl_mech == IRC_SASL_EXTERNAL ? "EXTERNAL" : "PLAIN");
+			lineEndPriority();
+			sasl_status = IRC_SASL_PENDING;
+		} else if (!more) {
+			endCapNegotiation();
+		}
+	} else if (!strcmp(sub, "NAK")) {
+		if (IRC_LOGGING(IRC_LOG_WARN)) {
+			Dbg->print(">> Capabilities refused: "); Dbg->println(list);
+		}
+		endCapNegotiation();
+	} else if (!strcmp(sub, "NEW")) {
+		caps = ircCapParse(list);
+		cap_available |= caps;
+		caps &= cap_wanted & ~cap_enabled;
+		if (caps)
+			sendCapRequest(caps);
+	} else if (!strcmp(sub, "DEL")) {
+		caps = ircCapParse(list);
+		cap_available &= ~caps;
+		cap_enabled &= ~caps;
+	}
+	return true;
+}
+
+/* SASL: "AUTHENTICATE +" asks for our credentials; 900-908 report the outcome.
+ * Either way registration continues afterward, logged in or not.
+ */
+static const char ircBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void IrcBotBase::sendSaslResponse(void)
+{
+	uint8_t raw[2 + IRC_SASL_ACCOUNT_MAXLEN + IRC_PASSWORD_MAXLEN];
+	char enc[(sizeof(raw) + 2) / 3 * 4 + 1];
+	unsigned int rawlen = 0, enclen = 0, i;
+	uint32_t v;
+
+	if (sasl_mech == IRC_SASL_EXTERNAL) {
+		lineAppend("AUTHENTICATE +");  // Empty response; the server already has our certificate
+		lineEndPriority();
+		return;
+	}
+
+	// PLAIN is "authzid\0authcid\0passwd"; an empty authzid means "the account we log in as"
+	raw[rawlen++] = '\0';
+	i = strlen(_saslacct);
+	memcpy(raw + rawlen, _saslacct, i);
+	rawlen += i;
+	raw[rawlen++] = '\0';
+	i = strlen(_saslpass);
+	memcpy(raw + rawlen, _saslpass, i);
+	rawlen += i;
+
+	for (i=0; i < rawlen; i += 3) {
+		v = (uint32_t)raw[i] << 16;
+		if (i+1 < rawlen) v |= (uint32_t)raw[i+1] << 8;
+		if (i+2 < rawlen) v |= raw[i+2];
+		enc[enclen++] = ircBase64[(v >> 18) & 0x3F];
+		enc[enclen++] = ircBase64[(v >> 12) & 0x3F];
+		enc[enclen++] = (i+1 < rawlen) ? ircBase64[(v >> 6) & 0x3F] : '=';
+		enc[enclen++] = (i+2 < rawlen) ? ircBase64[v & 0x3F] : '=';
+	}
+	enc[enclen] = '\0';
+	memset(raw, 0, sizeof(raw));
+
+	// Bounded by the field sizes to well under the 400 byte AUTHENTICATE chunk, so it always fits one line
+	lineAppend("AUTHENTICATE ");
+	lineAppend(enc);
+	lineEndPriority();
+	memset(enc, 0, sizeof(enc));
+}
+
+boolean IrcBotBase::handleSasl(IrcMessage *msg)
+{
+	switch (msg->cmdtoken) {
+		case IRC_CMDTOKEN_AUTHENTICATE:
+			if (sasl_status == IRC_SASL_PENDING && msg->paramc > 0 && !strcmp(msg->params[0], "+"))
+				sendSaslResponse();
+			break;
+		case 900:  // RPL_LOGGEDIN
+			if (IRC_LOGGING(IRC_LOG_INFO) && msg->paramc > 2) {
+				Dbg->print(">> Logged in as "); Dbg->println(msg->params[2]);
+			}
+			break;
+		case 903:  // RPL_SASLSUCCESS
+		case 907:  // ERR_SASLALREADY
+			sasl_status = IRC_SASL_SUCCESS;
+			endCapNegotiation();
+			break;
+		case 902:  // ERR_NICKLOCKED
+		case 904:  // ERR_SASLFAIL
+		case 905:  // ERR_SASLTOOLONG
+		case 906:  // ERR_SASLABORTED
+			if (sasl_status != IRC_SASL_PENDING)
+				break;
+			if (IRC_LOGGING(IRC_LOG_WARN)) {
+				Dbg->print(">> SASL authentication failed: "); Dbg->println(msg->params[msg->paramc-1]);
+			}
+			sasl_status = IRC_SASL_FAILED;
+			endCapNegotiation();
+			break;
+	}
+	return true;
+}
+
+/* RPL_ISUPPORT: "<nick> TOKEN[=value] -TOKEN ... :are supported by this server" */
+void IrcBotBase::isupportReset(void)
+{
+	memset(&isupport, 0, sizeof(isupport));
+	isupport.linelen = IRC_EGRESS_LINE_MAX;
+	isupport.nicklen = 9;
+	isupport.channellen = 200;
+	setCaseMapping(IRC_CASEMAP_RFC1459);
+	strcpy(isupport.chantypes, "#&");
+	strcpy(isupport.prefix_modes, "ov");
+	strcpy(isupport.prefix_chars, "@+");
+	strcpy(isupport.chanmodes_param, "beIk");
+	strcpy(isupport.chanmodes_setparam, "l");
+}
+
+// ISUPPORT numbers are unbounded; an empty value means "no limit"
+static uint8_t ircISupportNumber(const char *val, const uint8_t unlimited)
+{
+	unsigned long n;
+
+	if (val == NULL || *val == '\0')
+		return unlimited;
+	n = strtoul(val, NULL, 10);
+	return n > 0xFE ? 0xFE : n;
+}
+
+// Does tok (namelen chars) name the ISUPPORT parameter name?
+static boolean ircISupportIs(const char *tok, const unsigned int namelen, const char *name)
+{
+	return strlen(name) == namelen && !strncmp(tok, name, namelen);
+}
+
+boolean IrcBotBase::handleISupport(IrcMessage *msg)
+{
+	const char *tok, *val, *p, *limit;
+	int i;
+	unsigned int j, namelen, n = 0, group;
+	boolean negate;
+	unsigned long len;
+
+	for (i=1; i < msg->paramc; i++) {
+		tok = msg->params[i];
+		if (tok == msg->trailing)
+			continue;  // The trailing "are supported by this server"
+		negate = (tok[0] == '-');  // Parameter withdrawn; back to its default
+		if (negate)
+			tok++;
+		val = strchr(tok, '=');
+		namelen = (val == NULL) ? strlen(tok) : (unsigned int)(val - tok);
+		if (val != NULL)
+			val++;
+		if (negate)
+			val = NULL;
+
+		if (ircISupportIs(tok, namelen, "LINELEN")) {
+			len = (val != NULL && *val != '\0') ? strtoul(val, NULL, 10) : IRC_EGRESS_LINE_MAX;
+			if (len > IRC_EGRESS_LINE_MAX)
+				len = IRC_EGRESS_LINE_MAX;
+			if (len >= 64)  // Anything shorter can't be right
+				isupport.linelen = len;
+		} else if (ircISupportIs(tok, namelen, "NICKLEN")) {
+			isupport.nicklen = negate ? 9 : ircISupportNumber(val, 0xFE);
+		} else if (ircISupportIs(tok, namelen, "CHANNELLEN")) {
+			isupport.channellen = negate ? 200 : ircISupportNumber(val, 0xFE);
+		} else if (ircISupportIs(tok, namelen, "MAXTARGETS")) {
+			isupport.maxtargets = negate ? 0 : ircISupportNumber(val, IRC_TARGETS_UNLIMITED);
+		} else if (ircISupportIs(tok, namelen, "TARGMAX")) {
+			// TARGMAX=PRIVMSG:4,NOTICE:4,JOIN:
+			isupport.targmax_privmsg = isupport.targmax_notice = isupport.targmax_join = 0;
+			for (p = val; p != NULL && *p != '\0'; p += (p[n] == ',') ? n+1 : n) {
+				n = strcspn(p, ",");
+				limit = (const char *)memchr(p, ':', n);
+				namelen = (limit == NULL) ? n : (unsigned int)(limit - p);
+				j = (limit != NULL && limit+1 < p+n) ? ircISupportNumber(limit+1, IRC_TARGETS_UNLIMITED) : IRC_TARGETS_UNLIMITED;
+				if (ircISupportIs(p, namelen, "PRIVMSG"))
+					isupport.targmax_privmsg = j;
+				else if (ircISupportIs(p, namelen, "NOTICE"))
+					isupport.targmax_notice = j;
+				else if (ircISupportIs(p, namelen, "JOIN"))
+					isupport.targmax_join = j;
+			}
+		} else if (ircISupportIs(tok, namelen, "CASEMAPPING")) {
+			if (val == NULL || !strcmp(val, "rfc1459"))
+				setCaseMapping(IRC_CASEMAP_RFC1459);
+			else if (!strcmp(val, "strict-rfc1459"))
+				setCaseMapping(IRC_CASEMAP_STRICT_RFC1459);
+			else
+				setCaseMapping(IRC_CASEMAP_ASCII);  // ascii, and rfc7613 as far as we can fold it
+		} else if (ircISupportIs(tok, namelen, "CHANTYPES")) {
+			if (negate)
+				val = "#&";
+			strncpy(isupport.chantypes, val != NULL ? val : "", IRC_ISUPPORT_CHANTYPES_MAX);
+			isupport.chantypes[IRC_ISUPPORT_CHANTYPES_MAX] = '\0';
+		} else if (ircISupportIs(tok, namelen, "CHANLIMIT")) {
+			// CHANLIMIT=#&:20,+:10; types listed together share one limit
+			isupport.chanlimit_types[0] = '\0';
+			for (p = val, j = 0; p != NULL && *p != '\0'; ) {
+				limit = strchr(p, ':');
+				if (limit == NULL)
+					break;
+				n = ircISupportNumber(limit[1] == ',' ? NULL : limit+1, 0);
+				for (group = j; p < limit && j < IRC_ISUPPORT_CHANTYPES_MAX; p++, j++) {
+					isupport.chanlimit_types[j] = *p;
+					isupport.chanlimit[j] = n;
+					isupport.chanlimit_group[j] = group;
+				}
+				isupport.chanlimit_types[j] = '\0';
+				p = strchr(limit, ',');
+				if (p != NULL)
+					p++;
+			}
+		} else if (ircISupportIs(tok, namelen, "PREFIX")) {
+			// PREFIX=(ov)@+
+			if (negate)
+				val = "(ov)@+";
+			isupport.prefix_modes[0] = isupport.prefix_chars[0] = '\0';
+			if (val != NULL && val[0] == '(' && (p = strchr(val, ')')) != NULL) {
+				n = p - val - 1;
+				if (n > IRC_ISUPPORT_PREFIX_MAX)
+					n = IRC_ISUPPORT_PREFIX_MAX;
+				if (strlen(p+1) == (unsigned int)(p - val - 1)) {
+					memcpy(isupport.prefix_modes, val+1, n);
+					isupport.prefix_modes[n] = '\0';
+					memcpy(isupport.prefix_chars, p+1, n);
+					isupport.prefix_chars[n] = '\0';
+				}
+			}
+		} else if (ircISupportIs(tok, namelen, "CHANMODES")) {
+			// CHANMODES=A,B,C,D: types A and B always take a parameter, C only when set
+			if (negate || val == NULL)
+				val = "beI,k,l,";
+			n = strcspn(val, ",");
+			if (val[n] == ',')
+				n += 1 + strcspn(val + n + 1, ",");
+			j = 0;
+			for (p = val; p < val + n && j < IRC_ISUPPORT_CHANMODES_MAX; p++) {
+				if (*p != ',')
+					isupport.chanmodes_param[j++] = *p;
+			}
+			isupport.chanmodes_param[j] = '\0';
+			p = val + n + (val[n] == ',');
+			j = strcspn(p, ",");
+			if (j > IRC_ISUPPORT_CHANMODES_MAX)
+				j = IRC_ISUPPORT_CHANMODES_MAX;
+			memcpy(isupport.chanmodes_setparam, p, j);
+			isupport.chanmodes_setparam[j] = '\0';
+		}
+	}
+	return true;
+}
+
+/* Channel table: _ircchannels[] slots keep their index for life (callbacks refer to channels by it);
+ * chanHashIndex finds a name's slot in O(1), matching names the way the server's CASEMAPPING does.
+ * Folding is a range test rather than a table: every mapping folds a contiguous run starting at 'A'.
+ */
+void IrcBotBase::setCaseMapping(const uint8_t casemapping)
+{
+	uint8_t last = (casemapping == IRC_CASEMAP_ASCII) ? 'Z' : (casemapping == IRC_CASEMAP_STRICT_RFC1459) ? ']' : '^';
+
+	isupport.casemapping = casemapping;
+	if (last != casefold_last) {
+		casefold_last = last;
+		channelIndexRebuild();  // Names that collided before may not now, and vice versa
+#if IRC_MEMBERS_MAX > 0
+		if (members_max > 0) {
+			memset(nickHashIndex, 0, nickHashSlots * sizeof(nickHashIndex[0]));
+			for (unsigned int i=0; i < nicks_max; i++) {
+				if (nickTable[i].nick[0] != '\0')
+					nickIndexAdd(i);
+			}
+		}
+#endif
+	}
+}
+
+/* Remove entry (stored as entry+1) from an open-addressed hash index of mask+1 slots.  home(obj, entry)
+ * gives an entry's home slot.  Linear probing: shift later members of the probe chain back into the
+ * hole unless that would move them in front of their home slot.  Returns false if entry isn't indexed.
+ */
+static boolean ircHashIndexRemove(uint16_t *index, const unsigned int mask, const unsigned int entry,
+                                  unsigned int (*home)(const void *obj, const unsigned int entry), const void *obj)
+{
+	unsigned int slot, next, h;
+
+	slot = home(obj, entry);
+	while (index[slot] != entry+1) {
+		if (index[slot] == 0)
+			return false;
+		slot = (slot+1) & mask;
+	}
+	next = slot;
+	while (1) {
+		next = (next+1) & mask;
+		if (index[next] == 0)
+			break;
+		h = home(obj, index[next]-1);
+		if ( ((next - h) & mask) >= ((next - slot) & mask) ) {
+			index[slot] = index[next];
+			slot = next;
+		}
+	}
+	index[slot] = 0;
+	return true;
+}
+
+// FNV-1a over the casefolded name, folded to 16 bits
+uint16_t IrcBotBase::caseHash(const char *name)
+{
+	uint32_t h = 2166136261UL;
+
+	while (*name != '\0') {
+		h ^= caseFold(*name++);
+		h *= 16777619UL;
+	}
+	return (uint16_t)(h ^ (h >> 16));
+}
+
+boolean IrcBotBase::caseEqual(const char *a, const char *b)
+{
+	while (*a != '\0' && caseFold(*a) == caseFold(*b)) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+int IrcBotBase::channelLookup(const char *chan, unsigned int *slotp)
+{
+	uint16_t h;
+	unsigned int slot;
+	int i;
+
+	if (chan == NULL)
+		return -1;
+
+	h = caseHash(chan);
+	slot = h & (chanHashSlots-1);
+	while (chanHashIndex[slot] != 0) {
+		i = chanHashIndex[slot] - 1;
+		if (chanHash[i] == h && caseEqual(_ircchannels[i], chan)) {
+			if (slotp != NULL)
+				*slotp = slot;
+			return i;
+		}
+		slot = (slot+1) & (chanHashSlots-1);
+	}
+	return -1;
+}
+
+void IrcBotBase::channelIndexAdd(const int chanidx)
+{
+	unsigned int slot;
+
+	chanHash[chanidx] = caseHash(_ircchannels[chanidx]);
+	slot = chanHash[chanidx] & (chanHashSlots-1);
+	while (chanHashIndex[slot] != 0)
+		slot = (slot+1) & (chanHashSlots-1);
+	chanHashIndex[slot] = chanidx+1;
+}
+
+unsigned int IrcBotBase::channelHome(const void *bot, const unsigned int chanidx)
+{
+	const IrcBotBase *b = (const IrcBotBase *)bot;
+
+	return b->chanHash[chanidx] & (b->chanHashSlots-1);
+}
+
+void IrcBotBase::channelIndexRemove(const int chanidx)
+{
+	ircHashIndexRemove(chanHashIndex, chanHashSlots-1, chanidx, channelHome, this);
+}
+
+void IrcBotBase::channelIndexRebuild(void)
+{
+	int i;
+
+	memset(chanHashIndex, 0, chanHashSlots * sizeof(chanHashIndex[0]));
+	for (i=0; i < chan_max; i++) {
+		if (_ircchannels[i][0] != '\0')
+			channelIndexAdd(i);
+	}
+}
+
+// Is channel chanidx a channel name on this server, and do we have room under CHANLIMIT to join it?
+boolean IrcBotBase::channelAllowed(const int chanidx)
+{
+	const char *chan = _ircchannels[chanidx];
+	const char *t;
+	unsigned int i, type, count = 0;
+
+	if (strchr(isupport.chantypes, chan[0]) == NULL || strlen(chan) > isupport.channellen)
+		return false;
+	t = strchr(isupport.chanlimit_types, chan[0]);
+	if (t == NULL || isupport.chanlimit[t - isupport.chanlimit_types] == 0)
+		return true;
+	type = t - isupport.chanlimit_types;
+	for (i=0; i < (unsigned int)chan_max; i++) {
+		if ((int)i == chanidx || (chanState[i] != IRC_CHAN_JOINING && chanState[i] != IRC_CHAN_JOINED))
+			continue;
+		t = strchr(isupport.chanlimit_types, _ircchannels[i][0]);
+		if (t != NULL && isupport.chanlimit_group[t - isupport.chanlimit_types] == isupport.chanlimit_group[type])
+			count++;
+	}
+	return count < isupport.chanlimit[type];
+}
+
+/* How many comma separated targets the server takes in one PRIVMSG/NOTICE/JOIN.
+ * TARGMAX wins, then MAXTARGETS (PRIVMSG/NOTICE only); a server that says neither gets one message
+ * target at a time, but any number of channels per JOIN.
+ */
+unsigned int IrcBotBase::targetMax(const int cmdtoken)
+{
+	uint8_t n = 0;
+
+	switch (cmdtoken) {
+		case IRC_CMDTOKEN_PRIVMSG: n = isupport.targmax_privmsg; break;
+		case IRC_CMDTOKEN_NOTICE: n = isupport.targmax_notice; break;
+		case IRC_CMDTOKEN_JOIN: n = isupport.targmax_join; break;
+	}
+	if (n == 0 && cmdtoken == IRC_CMDTOKEN_JOIN)
+		return (unsigned int)-1;  // Channel lists have always been allowed in JOIN
+	if (n == 0)
+		n = isupport.maxtargets;
+	if (n == 0)
+		return 1;
+	return (n == IRC_TARGETS_UNLIMITED) ? (unsigned int)-1 : n;
+}
+
+/* Channel membership.  Nicks are interned in nickTable, one entry per person however many channels we
+ * share with them; memberTable holds one entry per (channel, nick), linked into that channel's list and
+ * that nick's list so PART/KICK, QUIT and NICK only touch the entries involved.  Both are hashed, so
+ * presence checks are O(1).  In a build or instance without membership the update functions do nothing.
+ */
+void IrcBotBase::memberReset(void)
+{
+#if IRC_MEMBERS_MAX > 0
+	unsigned int i;
+
+	nickCount = memberCount = 0;
+	if (members_max == 0)
+		return;
+	memset(nickHashIndex, 0, nickHashSlots * sizeof(nickHashIndex[0]));
+	memset(memberHashIndex, 0, memberHashSlots * sizeof(memberHashIndex[0]));
+	for (i=0; i < nicks_max; i++) {
+		nickTable[i].nick[0] = '\0';
+		nickTable[i].count = 0;
+		nickTable[i].first = (i+1 < nicks_max) ? i+1 : IRC_MEMBER_NONE;
+	}
+	for (i=0; i < members_max; i++)
+		memberTable[i].nick_next = (i+1 < members_max) ? i+1 : IRC_MEMBER_NONE;
+	nickFree = memberFree = 0;
+	for (i=0; i < (unsigned int)chan_max; i++) {
+		chanMembers[i] = IRC_MEMBER_NONE;
+		chanMemberCount[i] = 0;
+		chanNamesActive[i] = false;
+	}
+#endif
+}
+
+#if IRC_MEMBERS_MAX > 0
+int IrcBotBase::nickLookup(const char *nick, unsigned int *slotp)
+{
+	uint16_t h;
+	unsigned int slot;
+	int i;
+
+	if (members_max == 0)
+		return -1;
+	h = caseHash(nick);
+	slot = h & (nickHashSlots-1);
+	while (nickHashIndex[slot] != 0) {
+		i = nickHashIndex[slot] - 1;
+		if (nickTable[i].hash == h && caseEqual(nickTable[i].nick, nick)) {
+			if (slotp != NULL)
+				*slotp = slot;
+			return i;
+		}
+		slot = (slot+1) & (nickHashSlots-1);
+	}
+	return -1;
+}
+
+void IrcBotBase::nickIndexAdd(const unsigned int nickid)
+{
+	unsigned int slot;
+
+	nickTable[nickid].hash = caseHash(nickTable[nickid].nick);
+	slot = nickTable[nickid].hash & (nickHashSlots-1);
+	while (nickHashIndex[slot] != 0)
+		slot = (slot+1) & (nickHashSlots-1);
+	nickHashIndex[slot] = nickid+1;
+}
+
+unsigned int IrcBotBase::nickHome(const void *bot, const unsigned int nickid)
+{
+	const IrcBotBase *b = (const IrcBotBase *)bot;
+
+	return b->nickTable[nickid].hash & (b->nickHashSlots-1);
+}
+
+void IrcBotBase::nickIndexRemove(const unsigned int nickid)
+{
+	ircHashIndexRemove(nickHashIndex, nickHashSlots-1, nickid, nickHome, this);
+}
+
+int IrcBotBase::nickIntern(const char *nick)
+{
+	int i = nickLookup(nick);
+
+	if (i >= 0 || nickFree == IRC_MEMBER_NONE)
+		return i;
+	i = nickFree;
+	nickFree = nickTable[i].first;
+	strncpy(nickTable[i].nick, nick, IRC_NICKUSER_MAXLEN-1);
+	nickTable[i].nick[IRC_NICKUSER_MAXLEN-1] = '\0';
+	nickTable[i].first = IRC_MEMBER_NONE;
+	nickTable[i].count = 0;
+	nickIndexAdd(i);
+	nickCount++;
+	return i;
+}
+
+uint16_t IrcBotBase::memberHash(const unsigned int chanidx, const unsigned int nickid)
+{
+	uint32_t h = (nickid + 1) * 2654435761UL ^ chanidx * 40503UL;
+
+	return (uint16_t)(h ^ (h >> 16));
+}
+
+int IrcBotBase::memberLookup(const int chanidx, const int nickid, unsigned int *slotp)
+{
+	unsigned int slot;
+	int m;
+
+	if (chanidx < 0 || nickid < 0)
+		return -1;
+	slot = memberHash(chanidx, nickid) & (memberHashSlots-1);
+	while (memberHashIndex[slot] != 0) {
+		m = memberHashIndex[slot] - 1;
+		if (memberTable[m].chan == chanidx && memberTable[m].nick == nickid) {
+			if (slotp != NULL)
+				*slotp = slot;
+			return m;
+		}
+		slot = (slot+1) & (memberHashSlots-1);
+	}
+	return -1;
+}
+
+unsigned int IrcBotBase::memberHome(const void *bot, const unsigned int m)
+{
+	const IrcBotBase *b = (const IrcBotBase *)bot;
+
+	return memberHash(b->memberTable[m].chan, b->memberTable[m].nick) & (b->memberHashSlots-1);
+}
+
+void IrcBotBase::memberRemove(const unsigned int m)
+{
+	IrcMember *e = &memberTable[m];
+	IrcNickEntry *n = &nickTable[e->nick];
+
+	ircHashIndexRemove(memberHashIndex, memberHashSlots-1, m, memberHome, this);
+
+	if (e->chan_prev != IRC_MEMBER_NONE)
+		memberTable[e->chan_prev].chan_next = e->chan_next;
+	else
+		chanMembers[e->chan] = e->chan_next;
+	if (e->chan_next != IRC_MEMBER_NONE)
+		memberTable[e->chan_next].chan_prev = e->chan_prev;
+	if (e->nick_prev != IRC_MEMBER_NONE)
+		memberTable[e->nick_prev].nick_next = e->nick_next;
+	else
+		n->first = e->nick_next;
+	if (e->nick_next != IRC_MEMBER_NONE)
+		memberTable[e->nick_next].nick_prev = e->nick_prev;
+	chanMemberCount[e->chan]--;
+
+	if (--n->count == 0) {
+		// Last channel we saw them in; free the nick too
+		nickIndexRemove(e->nick);
+		n->nick[0] = '\0';
+		n->first = nickFree;
+		nickFree = e->nick;
+		nickCount--;
+	}
+	e->nick_next = memberFree;
+	memberFree = m;
+	memberCount--;
+}
+#endif /* IRC_MEMBERS_MAX */
+
+// Record nick in channel chanidx with the given prefix modes; returns its memberTable index or -1.
+int IrcBotBase::memberAdd(const int chanidx, const char *nick, const uint8_t modes)
+{
+#if IRC_MEMBERS_MAX > 0
+	IrcMember *e;
+	int id, m;
+	unsigned int slot;
+
+	if (members_max == 0)
+		return -1;
+	id = nickIntern(nick);
+	if (id < 0) {
+		member_overflows++;
+		return -1;
+	}
+	m = memberLookup(chanidx, id);
+	if (m >= 0) {
+		memberTable[m].modes = modes;
+		memberTable[m].flags &= ~IRC_MEMBER_STALE;
+		return m;
+	}
+	if (memberFree == IRC_MEMBER_NONE) {
+		member_overflows++;
+		if (nickTable[id].count == 0) {  // Interned just now; give it back
+			nickIndexRemove(id);
+			nickTable[id].nick[0] = '\0';
+			nickTable[id].first = nickFree;
+			nickFree = id;
+			nickCount--;
+		}
+		return -1;
+	}
+
+	m = memberFree;
+	e = &memberTable[m];
+	memberFree = e->nick_next;
+	e->nick = id;
+	e->chan = chanidx;
+	e->modes = modes;
+	e->flags = 0;
+	e->chan_prev = IRC_MEMBER_NONE;
+	e->chan_next = chanMembers[chanidx];
+	if (e->chan_next != IRC_MEMBER_NONE)
+		memberTable[e->chan_next].chan_prev = m;
+	chanMembers[chanidx] = m;
+	chanMemberCount[chanidx]++;
+	e->nick_prev = IRC_MEMBER_NONE;
+	e->nick_next = nickTable[id].first;
+	if (e->nick_next != IRC_MEMBER_NONE)
+		memberTable[e->nick_next].nick_prev = m;
+	nickTable[id].first = m;
+	nickTable[id].count++;
+
+	slot = memberHash(chanidx, id) & (memberHashSlots-1);
+	while (memberHashIndex[slot] != 0)
+		slot = (slot+1) & (memberHashSlots-1);
+	memberHashIndex[slot] = m+1;
+	memberCount++;
+	return m;
+#else
+	return -1;
+#endif
+}
+
+void IrcBotBase::memberPart(const int chanidx, const char *nick)
+{
+#if IRC_MEMBERS_MAX > 0
+	int m = memberLookup(chanidx, nickLookup(nick));
+
+	if (m >= 0)
+		memberRemove(m);
+#endif
+}
+
+void IrcBotBase::memberClearChannel(const int chanidx)
+{
+#if IRC_MEMBERS_MAX > 0
+	if (members_max == 0)
+		return;
+	while (chanMembers[chanidx] != IRC_MEMBER_NONE)
+		memberRemove(chanMembers[chanidx]);
+#endif
+}
+
+void IrcBotBase::memberQuit(const char *nick)
+{
+#if IRC_MEMBERS_MAX > 0
+	int id = nickLookup(nick);
+	unsigned int n;
+
+	if (id < 0)
+		return;
+	for (n = nickTable[id].count; n > 0; n--)
+		memberRemove(nickTable[id].first);  // The last one releases the nick entry
+#endif
 }
 
-unsigned int IrcBot::ringBufferSearchFlush(const uint8_t search)
+/* A NAMES list for a channel we already have members for (the sketch asked for one, or the server
+ * resent it) replaces them: everyone is marked stale at its first 353, the entries it lists are
+ * unmarked as they stream in, and whoever is still marked at the 366 has left unseen.
+ */
+void IrcBotBase::memberNamesBegin(const int chanidx)
 {
-	int i;
-	unsigned int end, count = 0;
-	uint8_t c;
+#if IRC_MEMBERS_MAX > 0
+	uint16_t m;
 
-	if (ringbuf_end < ringbuf_start)
-		end = IRC_INGRESS_RINGBUF_LEN + ringbuf_end;
-	else
-		end = ringbuf_end;
+	if (members_max == 0 || chanNamesActive[chanidx])
+		return;
+	chanNamesActive[chanidx] = true;
+	for (m = chanMembers[chanidx]; m != IRC_MEMBER_NONE; m = memberTable[m].chan_next)
+		memberTable[m].flags |= IRC_MEMBER_STALE;
+#endif
+}
 
-	for (i = ringbuf_start; i < end; i++) {
-		c = ringbuf[i % IRC_INGRESS_RINGBUF_LEN];
-		if (c != search) {
-			ringbuf_start++;
-			count++;
-		} else {
-			break;
-		}
+void IrcBotBase::memberNamesEnd(const int chanidx)
+{
+#if IRC_MEMBERS_MAX > 0
+	uint16_t m, next;
+
+	if (members_max == 0 || !chanNamesActive[chanidx])
+		return;
+	chanNamesActive[chanidx] = false;
+	for (m = chanMembers[chanidx]; m != IRC_MEMBER_NONE; m = next) {
+		next = memberTable[m].chan_next;
+		if (memberTable[m].flags & IRC_MEMBER_STALE)
+			memberRemove(m);
 	}
-	ringbuf_start = ringbuf_start % IRC_INGRESS_RINGBUF_LEN;
-	return count;
+#endif
 }
 
-unsigned int IrcBot::ringBufferConsume(void *buf, const unsigned int maxlen)
+// A nick change renames the one interned entry; every channel they're in sees it at once.
+void IrcBotBase::memberRename(const char *oldnick, const char *newnick)
 {
-	int i, origin = ringbuf_start;
-	unsigned int end, count = 0;
-	uint8_t c, *cbuf = (uint8_t *)buf;
+#if IRC_MEMBERS_MAX > 0
+	int id = nickLookup(oldnick), other;
 
-	if (ringbuf_end < ringbuf_start)
-		end = IRC_INGRESS_RINGBUF_LEN + ringbuf_end;
-	else
-		end = ringbuf_end;
-	if ( (end - ringbuf_start) > maxlen )
-		end = ringbuf_start + maxlen;
-
-	for (i = ringbuf_start; i < end; i++) {
-		c = ringbuf[i % IRC_INGRESS_RINGBUF_LEN];
-		cbuf[i-origin] = c;
-		ringbuf_start++;
-		count++;
+	if (id < 0)
+		return;
+	other = nickLookup(newnick);
+	if (other >= 0 && other != id) {
+		memberQuit(oldnick);  // We already have the new nick on record; trust that over the old one
+		return;
 	}
-	ringbuf_start = ringbuf_start % IRC_INGRESS_RINGBUF_LEN;
-	return count;
+	nickIndexRemove(id);
+	strncpy(nickTable[id].nick, newnick, IRC_NICKUSER_MAXLEN-1);
+	nickIndexAdd(id);
+#endif
 }
 
-unsigned int IrcBot::ringBufferFlush(const unsigned int count)
+// Strip the channel prefixes ("@+nick") off *nick, returning them as a prefix mode bitmask
+uint8_t IrcBotBase::prefixModes(const char **nick)
 {
-	int i;
-	unsigned int end, ttl;
-	uint8_t c;
-
-	if (ringbuf_end < ringbuf_start)
-		end = IRC_INGRESS_RINGBUF_LEN + ringbuf_end;
-	else
-		end = ringbuf_end;
-	
-	if ( (end - ringbuf_start) > count )
-		end = ringbuf_start + count;
-	ttl = end - ringbuf_start;
+	const char *p;
+	uint8_t modes = 0;
 
-	ringbuf_start = end % IRC_INGRESS_RINGBUF_LEN;
-	return ttl;
+	while (**nick != '\0' && (p = strchr(isupport.prefix_chars, **nick)) != NULL) {
+		modes |= 1 << (p - isupport.prefix_chars);
+		(*nick)++;
+	}
+	return modes;
 }
 
-void IrcBot::processInboundData(void)
-{
-	// Implement ring buffer for incoming data
-	int len;
-	int i, j, cmdtoken, chanidx;
-	char packet[IRC_INGRESS_RINGBUF_LEN], *arg1, *arg2, *argstart;
-	char tmpbuf[64];
-	char from_nick[IRC_NICKUSER_MAXLEN], from_user[IRC_NICKUSER_MAXLEN], from_host[IRC_SERVERNAME_MAXLEN];
-	char *tochan, *tonick = NULL, *tmp1 = NULL, *tmp2 = NULL, *msgstart = NULL;
-	boolean is_from_user, found_cmd, found_authnick;
-
-	Dbg->print("issuing read-");
-	len = conn.read(tcpbuf, IRC_INGRESS_BUFFER_LEN);
-	if (len > 0) {
-		Dbg->print("Stuffing "); Dbg->print(len); Dbg->println(" bytes into ring buffer-");
-		// Add data to ring buffer
-		for (i=0; i < len; i++) {
-			ringbuf[ringbuf_end++] = tcpbuf[i];
-			ringbuf_end = ringbuf_end % IRC_INGRESS_RINGBUF_LEN;
-		}
-	}
-	if (ringBufferLen() > 0 && _enabled && botState > IRC_DISCONNECTED) {
-		Dbg->print("Ring buffer has "); Dbg->print(ringBufferLen()); Dbg->println(" bytes; processing:");
-		// Process incoming message
-		while (ringBufferSearch('\r') >= 0) {  // A full message is available.
-			len = ringBufferSearchConsume(packet, '\r');
-			//Dbg->print("Read "); Dbg->print(len); Dbg->print(" bytes... ");
-			// Flush \r and \n
-			ringBufferFlush(2);
-			//Dbg->println("Flushed \\r\\n");
-
-			packet[len] = '\0';
-			Dbg->print("RECV: "); Dbg->println(packet);
-			// Packet contains our line; process!
-			arg1 = strstr(packet, " ");
-			if (arg1 == NULL) {
-				// Malformed line, discard.
-				continue;
+boolean IrcBotBase::handleMembership(IrcMessage *msg)
+{
+	int chanidx;
+	const char *names, *nick, *p;
+	char name[IRC_NICKUSER_MAXLEN];
+	unsigned int n, argi;
+	uint8_t modes;
+	boolean adding;
+#if IRC_MEMBERS_MAX > 0
+	int m;
+#endif
+
+	switch (msg->cmdtoken) {
+		case IRC_CMDTOKEN_NICK:
+			if (msg->nick == NULL || msg->paramc < 1)
+				break;
+			if (caseEqual(msg->nick, _ircnick)) {
+				if (self_prefixlen)
+					self_prefixlen += strlen(msg->params[0]) - strlen(_ircnick);
+				strncpy(_ircnick, msg->params[0], IRC_NICKUSER_MAXLEN-1);
 			}
-			*arg1 = '\0';
-			arg1++;
-			if (packet[0] == ':') {  // Message from a user or from the server; command or code is 2nd arg
-				arg2 = strstr(arg1, " ");
-				if (arg2 != NULL) {
-					*arg2 = '\0';
-					arg2++;
-				}
-				argstart = arg2;
-				cmdtoken = ircProtocolCommandToken(arg1);
-				Dbg->print(">> Line started with : - command token is "); Dbg->print(ircReplyCodeStrerror(cmdtoken)); Dbg->print("; argstart = ");
-				if (argstart == NULL)
-					Dbg->println("(null)");
-				else
-					Dbg->println(argstart);
+			memberRename(msg->nick, msg->params[0]);
+			break;
 
-				if (parseUserHostString(packet, from_nick, from_user, from_host))
-					is_from_user = true;
-				else
-					is_from_user = false;
+		case IRC_CMDTOKEN_QUIT:
+			if (msg->nick != NULL)
+				memberQuit(msg->nick);
+			break;
 
-				if (is_from_user) {
-					Dbg->print(">> Parsed \"From\": ");
-					Dbg->print("nick="); Dbg->print(from_nick);
-					Dbg->print(", user="); Dbg->print(from_user);
-					Dbg->print(", host="); Dbg->println(from_host);
-				} else {
-					Dbg->print("(unable to parse: "); Dbg->print(packet); Dbg->println(")");
+		case IRC_CMDTOKEN_KICK:
+			// KICK <channel> <nick> [:reason]
+			if (msg->paramc < 2 || (chanidx = channelLookup(msg->params[0])) < 0)
+				break;
+			if (caseEqual(msg->params[1], _ircnick)) {
+				chanState[chanidx] = IRC_CHAN_NOTJOINED;
+				if (IRC_LOGGING(IRC_LOG_INFO)) {
+					Dbg->print(">> We were kicked from channel "); Dbg->println(_ircchannels[chanidx]);
 				}
-			} else {  // Command is all alone with nothing in front indicating "who" or "where" it came from
-				is_from_user = false;
-				argstart = arg1;
-				cmdtoken = ircProtocolCommandToken(packet);
-				Dbg->print(">> Line started with cmd - command token is "); Dbg->print(ircReplyCodeStrerror(cmdtoken)); Dbg->print("; argstart = ");
-				Dbg->println(argstart);
+				memberClearChannel(chanidx);
+				executeOnChannelPartCallback(chanidx);
+			} else {
+				memberPart(chanidx, msg->params[1]);
 			}
+			break;
 
-			if (cmdtoken > 0) {
-				// Valid command or reply; process!
-
-				switch (cmdtoken) {
-					case IRC_CMDTOKEN_PING:  // Received ping, send PONG
-						if (argstart != NULL && argstart[0] == ':') {
-							strncpy(tmpbuf, argstart+1, 63);
-							strcpy(packet, "PONG ");
-							//strcat(packet, _ircuser);
-							//strcat(packet, " ");
-							strcat(packet, tmpbuf);
-						} else {
-							strcpy(packet, "PONG ");
-							strcat(packet, _ircuser);
-						}
-						strcat(packet, "\r\n");
-						Dbg->print(">> Responding with: "); Dbg->println(packet);
-						writebuf((char *)packet);
+		case IRC_CMDTOKEN_MODE:
+			// MODE <channel> +o-v <nick> <nick>; other modes' parameters have to be skipped over
+			if (msg->paramc < 2 || (chanidx = channelLookup(msg->params[0])) < 0)
+				break;
+			adding = true;
+			argi = 2;
+			for (p = msg->params[1]; *p != '\0'; p++) {
+				if (*p == '+' || *p == '-') {
+					adding = (*p == '+');
+				} else if ((names = strchr(isupport.prefix_modes, *p)) != NULL) {
+					if (argi >= (unsigned int)msg->paramc)
 						break;
-
-					case IRC_CMDTOKEN_PONG:  // Received PONG from a prior PING
-						Dbg->print(">> Received PONG: ");
-						if (argstart != NULL)
-							Dbg->println(argstart);
+					nick = msg->params[argi++];
+#if IRC_MEMBERS_MAX > 0
+					m = memberLookup(chanidx, nickLookup(nick));
+					if (m >= 0) {
+						modes = 1 << (names - isupport.prefix_modes);
+						if (adding)
+							memberTable[m].modes |= modes;
 						else
-							Dbg->println(" (no data)");
-						break;
+							memberTable[m].modes &= ~modes;
+					}
+#endif
+				} else if (strchr(isupport.chanmodes_param, *p) != NULL || (adding && strchr(isupport.chanmodes_setparam, *p) != NULL)) {
+					argi++;
+				}
+			}
+			break;
 
-					case IRC_CMDTOKEN_RPL_ENDOFMOTD:
-					case IRC_CMDTOKEN_ERR_NOMOTD:
-						if (botState > IRC_REGISTERING_USER)
-							botState = IRC_MOTD_FINISHED;
-						_hasmotd = true;
-						// Process event onMotdFinished
-						executeOnMotdFinishedCallback();
-						break;
+		case IRC_CMDTOKEN_RPL_NAMREPLY:
+			/* 353 <me> <symbol> <channel> :[prefixes]nick[!user@host] ...
+			 * A big channel's list comes as a run of these; each one is taken apart in place, a nick at
+			 * a time, so nothing beyond the line itself is ever held whatever the channel's size.
+			 */
+			if (msg->paramc < 4)
+				break;
+			chanidx = channelLookup(msg->params[2]);
+			if (chanidx < 0 && namesCallback == NULL)
+				break;  // Someone else's channel and no one to tell
+			if (chanidx >= 0)
+				memberNamesBegin(chanidx);
+			for (names = msg->params[3]; *names != '\0'; names += n) {
+				while (*names == ' ')
+					names++;
+				n = strcspn(names, " ");
+				if (n == 0)
+					break;
+				nick = names;
+				modes = prefixModes(&nick);
+				n -= nick - names;
+				names = nick;
+				argi = strcspn(nick, " !");  // userhost-in-names
+				if (argi >= IRC_NICKUSER_MAXLEN)
+					argi = IRC_NICKUSER_MAXLEN-1;
+				if (argi == 0)
+					continue;
+				memcpy(name, nick, argi);
+				name[argi] = '\0';
+				if (chanidx >= 0)
+					memberAdd(chanidx, name, modes);
+				if (namesCallback != NULL && _enabled)
+					namesCallback(namesCallbackUserobj, msg->params[2], name, modes);
+			}
+			break;
 
-					case IRC_CMDTOKEN_JOIN:
-					case IRC_CMDTOKEN_PART:
-						// What's the channel?
-						arg2 = strstr(argstart, " ");
-						if (arg2 != NULL)
-							*arg2 = '\0';
-						if (argstart[0] == ':') {  // Some IRC servers do that; the channel is prepended with a : for some odd reason...
-							argstart++;
-						}
-						for (chanidx = 0; chanidx < IRC_CHANNEL_MAX; chanidx++) {
-							if (!strncmp(argstart, _ircchannels[chanidx], IRC_CHANNEL_MAXLEN))
-								break;
-						}
-						if (chanidx != IRC_CHANNEL_MAX) {
-							// Is this in relation to us?
-							if (is_from_user) {
-								if (strcmp(from_nick, _ircnick) == 0) {
-									if (cmdtoken == IRC_CMDTOKEN_JOIN) {
-										if (chanState[chanidx] == IRC_CHAN_JOINING) {
-											chanState[chanidx] = IRC_CHAN_JOINED;
-											Dbg->print(">> Confirmed JOIN for channel "); Dbg->println(_ircchannels[chanidx]);
-											// Execute channel JOIN callback if registered
-											executeOnChannelJoinCallback(chanidx);
-										}
-									} else {  // IRC_CMDTOKEN_PART
-										chanState[chanidx] = IRC_CHAN_NOTJOINED;
-										Dbg->print(">> We have PARTed channel "); Dbg->println(_ircchannels[chanidx]);
-										// Execute channel PART callback if registered
-										executeOnChannelPartCallback(chanidx);
-									} /* if(cmdtoken == IRC_CMDTOKEN_JOIN or not) */
-								} else {
-									// No, this is notifying us of someone else joining/parting a channel
-									// See if an appropriate callback has been registered for this one.
-									if (cmdtoken == IRC_CMDTOKEN_JOIN) {
-										for (i=0; i < IRC_CALLBACK_MAX_CHANNELNICK; i++) {
-											if (channelUserJoinCallbacks[i].chanidx == chanidx &&
-												channelUserJoinCallbacks[i].callback != NULL &&
-												!strncmp(channelUserJoinCallbacks[i].nick, from_nick, IRC_NICKUSER_MAXLEN)) {
-
-												Dbg->print(">> Executing OnChannelUserJoin callback for channel ");
-												Dbg->print(_ircchannels[chanidx]); Dbg->print(" and nick=");
-												Dbg->println(channelUserJoinCallbacks[i].nick);
-												channelUserJoinCallbacks[i].callback(channelUserJoinCallbacks[i].userobj,
-																					 _ircchannels[chanidx],
-																					 channelUserJoinCallbacks[i].nick);
-											}
-										}
-									} else {  // IRC_CMDTOKEN_PART
-										for (i=0; i < IRC_CALLBACK_MAX_CHANNELNICK; i++) {
-											if (channelUserPartCallbacks[i].chanidx == chanidx &&
-												channelUserPartCallbacks[i].callback != NULL &&
-												!strncmp(channelUserPartCallbacks[i].nick, from_nick, IRC_NICKUSER_MAXLEN)) {
-
-												Dbg->print(">> Executing OnChannelUserPart callback for channel ");
-												Dbg->print(_ircchannels[chanidx]); Dbg->print(" and nick=");
-												Dbg->println(channelUserJoinCallbacks[i].nick);
-												channelUserPartCallbacks[i].callback(channelUserPartCallbacks[i].userobj,
-																					 _ircchannels[chanidx],
-																					 channelUserPartCallbacks[i].nick);
-											}
-										}
-									} /* if(cmdtoken == IRC_CMDTOKEN_JOIN or not) */
-								}
-							}
-						} else {
-							// A message from an invalid channel?  Odd...
-							if (cmdtoken == IRC_CMDTOKEN_JOIN)
-								Dbg->print(">> Received a JOIN message for a channel we don't have in our registry! (");
-							else
-								Dbg->print(">> Received a PART message for a channel we don't have in our registry! (");
-							Dbg->print(argstart);
-							Dbg->println(")");
-						}
-						break;
+		case IRC_CMDTOKEN_RPL_ENDOFNAMES:
+			// 366 <me> <channel> :End of /NAMES list.
+			if (msg->paramc < 2)
+				break;
+			chanidx = channelLookup(msg->params[1]);
+			if (chanidx >= 0)
+				memberNamesEnd(chanidx);
+			if (namesCallback != NULL && _enabled)
+				namesCallback(namesCallbackUserobj, msg->params[1], NULL, 0);
+			break;
+	}
+	return true;
+}
+
+boolean IrcBotBase::isOnChannel(const char *chan, const char *nick)
+{
+	return getMemberModes(chan, nick) >= 0;
+}
 
+int IrcBotBase::getMemberModes(const char *chan, const char *nick)
+{
+#if IRC_MEMBERS_MAX > 0
+	int m = memberLookup(channelLookup(chan), nickLookup(nick));
 
-					case IRC_CMDTOKEN_PRIVMSG:
-						if (is_from_user) {
-							Dbg->print(">> Privmsg params: From nick="); Dbg->print(from_nick);
-							Dbg->print(" (user="); Dbg->print(from_user);
-							Dbg->print("); argstart="); Dbg->println(argstart);
-						} else {
-							Dbg->print(">> Privmsg params: argstart="); Dbg->println(argstart);
-						}
-						tochan = argstart;
-						tonick = strstr(tochan, " ");
-						if (tonick == NULL) {
-							Dbg->println(">> Malformed PRIVMSG; No space between channel and message : delimiter");
-							break;  // Malformed PRIVMSG line?
-						}
-						*tonick = '\0';
-						tonick++;
-						if (*tonick != ':') {
-							Dbg->println(">> Malformed PRIVMSG; No : indicating start-of-message");
-							break;  // Malformed PRIVMSG line, missing the : for the remaining message?
-						}
-						tonick++;
-						tmp1 = strstr(tonick, ":");
-						if (tmp1 != NULL) {
-							*tmp1 = '\0';
-							if (strstr(tonick, " ") != NULL) {
-								*tmp1 = ' ';  // restore the space; this isn't a nick-targeted message.
-							} else {
-								do {
-									tmp1++;
-								} while (*tmp1 == ' ');
-								msgstart = tmp1;
-							}
-						} else {
-							msgstart = tonick;
-							tonick = NULL;
-						}
+	if (m >= 0)
+		return memberTable[m].modes;
+#endif
+	return -1;
+}
 
-						/* At this point, chan = NUL-terminated channel name, tonick = NUL-terminated target nickname if present or NULL if not,
-						 * and msgstart points to the real message.
-						 */
-						Dbg->print(">> Privmsg CHAN="); Dbg->print(tochan); Dbg->print(", ToNick=");
-						if (tonick != NULL)
-							Dbg->print(tonick);
-						else
-							Dbg->print("(none applicable)");
-						Dbg->print(", Message=");
-						Dbg->println(msgstart);
-
-						if (tonick != NULL && strcmp(tonick, _ircnick) == 0) {
-							Dbg->println(">> Message directed to us; running command processing subsystem");
-							// Message directed to us; search command registry and send to callback!
-							tmp1 = strstr(msgstart, " ");
-							if (tmp1 != NULL) {
-								*tmp1 = '\0';
-								tmp1++;
-							}
-							found_cmd = false;
-							for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-								if (commandCallbackRegistry[i].cmd != NULL &&
-									commandCallbackRegistry[i].callback != NULL &&
-									!strcmp(msgstart, commandCallbackRegistry[i].cmd)) {  // Found a match; execute!
-									found_cmd = true;
-									// Handle authnicks authentication
-									if (commandCallbackRegistry[i].authnicks == NULL) {
-										Dbg->println(">> Executing callback");
-										commandCallbackRegistry[i].callback(commandCallbackRegistry[i].userobj,
-																			tochan,
-																			from_nick,
-																			tmp1);
-									} else {
-										// Source nick is in from_nick
-										j = 0;
-										tmp2 = commandCallbackRegistry[i].authnicks[j];
-										found_authnick = false;
-										while (tmp2 != NULL && tmp2[0] != '\0') {
-											if (!strncmp(from_nick, tmp2, IRC_NICKUSER_MAXLEN)) {
-												// Found from_nick in authnicks; proceed to execute callback
-												found_authnick = true;
-												Dbg->println(">> Nick authorized; executing callback");
-												commandCallbackRegistry[i].callback(commandCallbackRegistry[i].userobj,
-																					tochan,
-																					from_nick,
-																					tmp1);
-												break;
-											}
-											j++;
-											tmp2 = commandCallbackRegistry[i].authnicks[j];
-										}
-										if (!found_authnick) {
-											Dbg->println(">> Nick not found in authnicks list.");
-											if (commandCallbackRegistry[i].unauth_callback != NULL) {
-												Dbg->println(">> Executing unauthorized-attempt callback for this command");
-												commandCallbackRegistry[i].unauth_callback(commandCallbackRegistry[i].userobj,
-																						   tochan,
-																						   from_nick,
-																						   tmp1);
-											}
-										}
-									} /* if (authnicks == NULL) */
-								} /* if (found a matching callback for this command) */
-							} /* for (each item in command callback registry) */
-							if (!found_cmd && unknownCommandCallback != NULL) {
-								Dbg->println(">> Executing unknown-command callback routine");
-								unknownCommandCallback(unknownCommandCallbackUserobj, tochan, from_nick, tmp1);
-							}
-						}
-						break;
+char IrcBotBase::getMemberPrefix(const char *chan, const char *nick)
+{
+	int modes = getMemberModes(chan, nick);
+	unsigned int i;
 
-					case IRC_CMDTOKEN_ERR_ERRONEOUSNICKNAME:
-					case IRC_CMDTOKEN_ERR_NICKNAMEINUSE:
-					case IRC_CMDTOKEN_ERR_NICKCOLLISION:
-						Dbg->println(">> Server reported nickname in use or invalid!");
-						strcat(_ircnick, "_");
-						botState = IRC_SERVERINIT;
-						return;
+	for (i=0; modes > 0 && isupport.prefix_chars[i] != '\0'; i++) {
+		if (modes & (1 << i))
+			return isupport.prefix_chars[i];
+	}
+	return '\0';
+}
 
-					case IRC_CMDTOKEN_RPL_WELCOME:
-					case IRC_CMDTOKEN_ERR_ALREADYREGISTERED:
-						if (botState == IRC_REGISTERING_USER) {
-							botState++;
-							if (_hasmotd)
-								botState++;  // Advance past user registration completely
-						}
-						break;
+unsigned int IrcBotBase::getMemberCount(const char *chan)
+{
+#if IRC_MEMBERS_MAX > 0
+	int chanidx = channelLookup(chan);
 
-					case IRC_CMDTOKEN_ERR_YOUREBANNEDCREEP:
-						Dbg->println(">> Server reported that we're banned; disabling bot.");
-						end();
-						return;
+	if (chanidx >= 0 && members_max > 0)
+		return chanMemberCount[chanidx];
+#endif
+	return 0;
+}
 
-					default:
-						if (botState == IRC_CONNECTED)
-							botState++;
-						break;
+unsigned int IrcBotBase::getMembers(const char *chan, const char **nicks, unsigned int max, char minprefix)
+{
+	unsigned int count = 0;
+#if IRC_MEMBERS_MAX > 0
+	int chanidx = channelLookup(chan);
+	const char *p;
+	uint8_t mask = 0xFF;
+	uint16_t m;
+
+	if (chanidx < 0 || members_max == 0)
+		return 0;
+	if (minprefix != '\0') {
+		p = strchr(isupport.prefix_chars, minprefix);
+		if (p == NULL)
+			return 0;
+		mask = (2 << (p - isupport.prefix_chars)) - 1;  // That rank and every one above it
+	}
+	for (m = chanMembers[chanidx]; m != IRC_MEMBER_NONE && count < max; m = memberTable[m].chan_next) {
+		if (minprefix == '\0' || (memberTable[m].modes & mask))
+			nicks[count++] = nickTable[memberTable[m].nick].nick;
+	}
+#endif
+	return count;
+}
 
-				}
-			}
-		}
+void IrcBotBase::getMemberStats(IrcMemberStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+#if IRC_MEMBERS_MAX > 0
+	stats->nicks = nickCount;
+	stats->members = memberCount;
+	stats->overflows = member_overflows;
+	if (members_max == 0)
+		return;
+	stats->bytesUsed = nickCount * (sizeof(IrcNickEntry) + nickHashSlots * sizeof(uint16_t) / nicks_max) +
+	                   memberCount * (sizeof(IrcMember) + memberHashSlots * sizeof(uint16_t) / members_max);
+	stats->bytesPerMember = memberCount ? stats->bytesUsed / memberCount : 0;
+	stats->bytesReserved = nicks_max * sizeof(IrcNickEntry) + nickHashSlots * sizeof(uint16_t) +
+	                       members_max * sizeof(IrcMember) + memberHashSlots * sizeof(uint16_t) +
+	                       chan_max * (2 * sizeof(uint16_t) + sizeof(boolean));
+#endif
+}
+
+boolean IrcBotBase::handleBanned(IrcMessage *msg)
+{
+	if (IRC_LOGGING(IRC_LOG_ERROR)) {
+		Dbg->println(">> Server reported that we're banned; disabling bot.");
 	}
+	end();
+	return false;
 }
 
 /* Callback handler maintenance - Commands */
-boolean IrcBot::attachOnCommand( const char *cmd, IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
+boolean IrcBotBase::attachOnCommand( const char *cmd, IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
 {
 	return attachOnCommand(cmd, NULL, callback, userobj);
 }
 
-boolean IrcBot::attachOnCommand( const char *cmd, const char **authnicks, IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
+boolean IrcBotBase::attachOnCommand( const char *cmd, const char **authnicks, IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
 {
 	int i;
+	unsigned int slot;
 
-	for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-		if (commandCallbackRegistry[i].cmd != NULL && !strcmp(commandCallbackRegistry[i].cmd, cmd)) {
-			return false;  // Command already registered!
-		}
-
-		if (commandCallbackRegistry[i].cmd == NULL || commandCallbackRegistry[i].callback == NULL) {
-			commandCallbackRegistry[i].cmd = (char *)cmd;
-			commandCallbackRegistry[i].callback = callback;
-			commandCallbackRegistry[i].unauth_callback = NULL;  // This can be initialized with attachOnCommandUnauthorized
-			commandCallbackRegistry[i].userobj = (void *)userobj;
-			commandCallbackRegistry[i].authnicks = (char **)authnicks;
-			return true;
-		}
-	}
-	return false;  // Out of command registry entries
+	if (cmd == NULL || callback == NULL)
+		return false;
+	if (commandLookup(cmd) >= 0)
+		return false;  // Command already registered!
+	if (commandCount == (unsigned int)cmd_max)
+		return false;  // Out of command registry entries
+
+	i = commandCount++;
+	commandCallbackRegistry[i].cmd = (char *)cmd;
+	commandCallbackRegistry[i].hash = ircCommandHash(cmd);
+	commandCallbackRegistry[i].callback = callback;
+	commandCallbackRegistry[i].unauth_callback = NULL;  // This can be initialized with attachOnCommandUnauthorized
+	commandCallbackRegistry[i].userobj = (void *)userobj;
+	commandCallbackRegistry[i].authnicks = (char **)authnicks;
+
+	slot = commandCallbackRegistry[i].hash & (commandHashSlots-1);
+	while (commandHashIndex[slot] != 0)
+		slot = (slot+1) & (commandHashSlots-1);
+	commandHashIndex[slot] = i+1;
+	return true;
 }
 
-boolean IrcBot::detachOnCommand(const char *cmd)
+unsigned int IrcBotBase::commandHome(const void *bot, const unsigned int i)
 {
-	int i;
+	const IrcBotBase *b = (const IrcBotBase *)bot;
 
-	for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-		if (commandCallbackRegistry[i].cmd != NULL && !strcmp(commandCallbackRegistry[i].cmd, cmd)) {
-			commandCallbackRegistry[i].cmd = NULL;
-			commandCallbackRegistry[i].callback = NULL;
-			commandCallbackRegistry[i].unauth_callback = NULL;
-			commandCallbackRegistry[i].userobj = NULL;
-			commandCallbackRegistry[i].authnicks = NULL;
-			return true;
-		}
+	return b->commandCallbackRegistry[i].hash & (b->commandHashSlots-1);
+}
+
+boolean IrcBotBase::detachOnCommand(const char *cmd)
+{
+	int i, last;
+	unsigned int slot;
+
+	i = commandLookup(cmd);
+	if (i < 0)
+		return false;  // Command not found in the command callback registry
+
+	ircHashIndexRemove(commandHashIndex, commandHashSlots-1, i, commandHome, this);
+
+	// Keep the registry dense; move the last entry into the freed one and repoint its index slot.
+	last = --commandCount;
+	if (i != last) {
+		commandCallbackRegistry[i] = commandCallbackRegistry[last];
+		slot = commandCallbackRegistry[i].hash & (commandHashSlots-1);
+		while (commandHashIndex[slot] != last+1)
+			slot = (slot+1) & (commandHashSlots-1);
+		commandHashIndex[slot] = i+1;
 	}
-	return false;  // Command not found in the command callback registry
+	return true;
 }
 
-boolean IrcBot::attachOnUnknownCommand( IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
+boolean IrcBotBase::attachOnUnknownCommand( IRC_CALLBACK_TYPE_COMMAND callback, const void *userobj )
 {
 	if (unknownCommandCallback != NULL)
 		return false;
@@ -980,7 +3156,7 @@ boolean IrcBot::attachOnUnknownCommand( IRC_CALLBACK_TYPE_COMMAND callback, cons
 	return true;
 }
 
-boolean IrcBot::detachOnUnknownCommand(void)
+boolean IrcBotBase::detachOnUnknownCommand(void)
 {
 	if (unknownCommandCallback == NULL)
 		return false;
@@ -990,36 +3166,129 @@ boolean IrcBot::detachOnUnknownCommand(void)
 	return true;
 }
 
-boolean IrcBot::attachOnCommandUnauthorized( const char *cmd, IRC_CALLBACK_TYPE_COMMAND callback )
+boolean IrcBotBase::attachOnCommandUnauthorized( const char *cmd, IRC_CALLBACK_TYPE_COMMAND callback )
 {
-	int i;
+	int i = commandLookup(cmd);
 
-	for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-		if (commandCallbackRegistry[i].cmd != NULL && !strcmp(commandCallbackRegistry[i].cmd, cmd)) {
-			commandCallbackRegistry[i].unauth_callback = callback;
-			return true;
-		}
-	}
+	if (i < 0)
+		return false;  // Command not found in registry
+
+	commandCallbackRegistry[i].unauth_callback = callback;
+	return true;
+}
+
+boolean IrcBotBase::detachOnCommandUnauthorized( const char *cmd )
+{
+	int i = commandLookup(cmd);
+
+	if (i < 0)
+		return false;  // Command not found in registry
+
+	commandCallbackRegistry[i].unauth_callback = NULL;
+	return true;
+}
+
+// FNV-1a, folded to 16 bits; only used to place & pre-filter commands in the hash index.
+uint16_t IrcBotBase::ircCommandHash(const char *cmd)
+{
+	uint32_t h = 2166136261UL;
 
-	return false;  // Command not found in registry
+	while (*cmd != '\0') {
+		h ^= (uint8_t)*cmd++;
+		h *= 16777619UL;
+	}
+	return (uint16_t)(h ^ (h >> 16));
 }
 
-boolean IrcBot::detachOnCommandUnauthorized( const char *cmd )
+/* Find a registered command through the hash index.  Returns its commandCallbackRegistry index or -1;
+ * the index slot it was found in is stored in *slotp if requested.
+ */
+int IrcBotBase::commandLookup(const char *cmd, unsigned int *slotp)
 {
+	uint16_t h;
+	unsigned int slot;
 	int i;
 
-	for (i=0; i < IRC_COMMAND_REGISTRY_MAX; i++) {
-		if (commandCallbackRegistry[i].cmd != NULL && !strcmp(commandCallbackRegistry[i].cmd, cmd)) {
-			commandCallbackRegistry[i].unauth_callback = NULL;
-			return true;
+	if (cmd == NULL)
+		return -1;
+
+	h = ircCommandHash(cmd);
+	slot = h & (commandHashSlots-1);
+	while (commandHashIndex[slot] != 0) {
+		i = commandHashIndex[slot] - 1;
+		if (commandCallbackRegistry[i].hash == h && !strcmp(commandCallbackRegistry[i].cmd, cmd)) {
+			if (slotp != NULL)
+				*slotp = slot;
+			return i;
 		}
+		slot = (slot+1) & (commandHashSlots-1);
 	}
+	return -1;
+}
+
+/* Callback handler maintenance - Server replies & commands flagged IRC_REPLY_FORWARD */
+boolean IrcBotBase::attachOnReply(IRC_CALLBACK_TYPE_MESSAGE callback, const void *userobj)
+{
+	if (replyCallback != NULL)
+		return false;  // Already registered!
+
+	replyCallback = callback;
+	replyCallbackUserobj = (void *)userobj;
+	return true;
+}
+
+boolean IrcBotBase::detachOnReply(void)
+{
+	if (replyCallback == NULL)
+		return false;  // Not registered in the first place!
+
+	replyCallback = NULL;
+	replyCallbackUserobj = NULL;
+	return true;
+}
+
+boolean IrcBotBase::attachOnReconnect(IRC_CALLBACK_TYPE_RECONNECT callback, const void *userobj)
+{
+	if (reconnectCallback != NULL)
+		return false;  // Already registered!
+
+	reconnectCallback = callback;
+	reconnectCallbackUserobj = (void *)userobj;
+	return true;
+}
+
+boolean IrcBotBase::detachOnReconnect(void)
+{
+	if (reconnectCallback == NULL)
+		return false;  // Not registered in the first place!
+
+	reconnectCallback = NULL;
+	reconnectCallbackUserobj = NULL;
+	return true;
+}
+
+boolean IrcBotBase::attachOnNames(IRC_CALLBACK_TYPE_NAMES callback, const void *userobj)
+{
+	if (namesCallback != NULL)
+		return false;  // Already registered!
+
+	namesCallback = callback;
+	namesCallbackUserobj = (void *)userobj;
+	return true;
+}
 
-	return false;  // Command not found in registry
+boolean IrcBotBase::detachOnNames(void)
+{
+	if (namesCallback == NULL)
+		return false;  // Not registered in the first place!
+
+	namesCallback = NULL;
+	namesCallbackUserobj = NULL;
+	return true;
 }
 
 /* Callback handler maintenance - Connect/Disconnect */
-boolean IrcBot::attachOnConnect(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
+boolean IrcBotBase::attachOnConnect(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
 {
 	if (connectCallback != NULL)
 		return false;  // Already registered!
@@ -1029,7 +3298,7 @@ boolean IrcBot::attachOnConnect(IRC_CALLBACK_TYPE_CONNECT callback, const void *
 	return true;
 }
 
-boolean IrcBot::detachOnConnect(void)
+boolean IrcBotBase::detachOnConnect(void)
 {
 	if (connectCallback == NULL)
 		return false;  // Not registered in the first place!
@@ -1039,15 +3308,16 @@ boolean IrcBot::detachOnConnect(void)
 	return true;
 }
 
-void IrcBot::executeOnConnectCallback(void)
+void IrcBotBase::executeOnConnectCallback(void)
 {
 	if (connectCallback != NULL) {
-		Dbg->println(">> Executing OnConnect callback");
+		if (IRC_LOGGING(IRC_LOG_DEBUG))
+			Dbg->println(">> Executing OnConnect callback");
 		connectCallback(connectCallbackUserobj);
 	}
 }
 
-boolean IrcBot::attachOnDisconnect(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
+boolean IrcBotBase::attachOnDisconnect(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
 {
 	if (disconnectCallback != NULL)
 		return false;  // Already registered!
@@ -1057,7 +3327,7 @@ boolean IrcBot::attachOnDisconnect(IRC_CALLBACK_TYPE_CONNECT callback, const voi
 	return true;
 }
 
-boolean IrcBot::detachOnDisconnect(void)
+boolean IrcBotBase::detachOnDisconnect(void)
 {
 	if (disconnectCallback == NULL)
 		return false;  // Not registered in the first place!
@@ -1067,16 +3337,17 @@ boolean IrcBot::detachOnDisconnect(void)
 	return true;
 }
 
-void IrcBot::executeOnDisconnectCallback(void)
+void IrcBotBase::executeOnDisconnectCallback(void)
 {
 	if (disconnectCallback != NULL) {
-		Dbg->println(">> Executing OnDisconnect callback");
+		if (IRC_LOGGING(IRC_LOG_DEBUG))
+			Dbg->println(">> Executing OnDisconnect callback");
 		disconnectCallback(disconnectCallbackUserobj);
 	}
 }
 
 /* Callback handler - On MOTD finished (fully attached to IRC server, ready to run commands) */
-boolean IrcBot::attachOnMotdFinished(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
+boolean IrcBotBase::attachOnMotdFinished(IRC_CALLBACK_TYPE_CONNECT callback, const void *userobj)
 {
 	if (motdFinishedCallback != NULL)
 		return false;  // Already registered!
@@ -1086,7 +3357,7 @@ boolean IrcBot::attachOnMotdFinished(IRC_CALLBACK_TYPE_CONNECT callback, const v
 	return true;
 }
 
-boolean IrcBot::detachOnMotdFinished(void)
+boolean IrcBotBase::detachOnMotdFinished(void)
 {
 	if (motdFinishedCallback == NULL)
 		return false;  // Not registered in the first place!
@@ -1096,155 +3367,147 @@ boolean IrcBot::detachOnMotdFinished(void)
 	return true;
 }
 
-void IrcBot::executeOnMotdFinishedCallback(void)
+void IrcBotBase::executeOnMotdFinishedCallback(void)
 {
 	if (motdFinishedCallback != NULL) {
-		Dbg->println(">> Executing OnMotdFinished callback");
+		if (IRC_LOGGING(IRC_LOG_DEBUG))
+			Dbg->println(">> Executing OnMotdFinished callback");
 		motdFinishedCallback(motdFinishedCallbackUserobj);
 	}
 }
 
 /* Callback handler maintenance - Channel Join/Part (Us only) */
-boolean IrcBot::attachOnJoin(const char *channel, IRC_CALLBACK_TYPE_CHANNEL callback, const void *userobj)
+boolean IrcBotBase::attachOnJoin(const char *channel, IRC_CALLBACK_TYPE_CHANNEL callback, const void *userobj)
 {
 	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			if (channelJoinCallbacks[i].callback == NULL) {
-				channelJoinCallbacks[i].callback = callback;
-				channelJoinCallbacks[i].userobj = (void *)userobj;
-				return true;
-			} else {
-				return false;  // Channel found, but, a handler is already registered!
-			}
-		}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
+	if (channelJoinCallbacks[i].callback == NULL) {
+		channelJoinCallbacks[i].callback = callback;
+		channelJoinCallbacks[i].userobj = (void *)userobj;
+		return true;
+	} else {
+		return false;  // Channel found, but, a handler is already registered!
 	}
-	return false;  // Channel not found in current bot configuration
 }
 
-boolean IrcBot::detachOnJoin(const char *channel)
+boolean IrcBotBase::detachOnJoin(const char *channel)
 {
 	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			if (channelJoinCallbacks[i].callback != NULL) {
-				channelJoinCallbacks[i].callback = NULL;
-				channelJoinCallbacks[i].userobj = NULL;
-				return true;
-			} else {
-				return false;  // Channel found, but, no handler was registered.
-			}
-		}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
+	if (channelJoinCallbacks[i].callback != NULL) {
+		channelJoinCallbacks[i].callback = NULL;
+		channelJoinCallbacks[i].userobj = NULL;
+		return true;
+	} else {
+		return false;  // Channel found, but, no handler was registered.
 	}
-	return false;  // Channel not found in current bot configuration
 }
 
-void IrcBot::executeOnChannelJoinCallback(const int chanidx)
+void IrcBotBase::executeOnChannelJoinCallback(const int chanidx)
 {
 	if (channelJoinCallbacks[chanidx].callback != NULL) {
-		Dbg->print(">> Executing OnChannelJoin callback for channel "); Dbg->println(_ircchannels[chanidx]);
+		if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+			Dbg->print(">> Executing OnChannelJoin callback for channel "); Dbg->println(_ircchannels[chanidx]);
+		}
 		channelJoinCallbacks[chanidx].callback(channelJoinCallbacks[chanidx].userobj, _ircchannels[chanidx]);
 	}
 }
 
-boolean IrcBot::attachOnPart(const char *channel, IRC_CALLBACK_TYPE_CHANNEL callback, const void *userobj)
+boolean IrcBotBase::attachOnPart(const char *channel, IRC_CALLBACK_TYPE_CHANNEL callback, const void *userobj)
 {
 	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			if (channelPartCallbacks[i].callback == NULL) {
-				channelPartCallbacks[i].callback = callback;
-				channelPartCallbacks[i].userobj = (void *)userobj;
-				return true;
-			} else {
-				return false;  // Channel found, but, a handler is already registered!
-			}
-		}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
+	if (channelPartCallbacks[i].callback == NULL) {
+		channelPartCallbacks[i].callback = callback;
+		channelPartCallbacks[i].userobj = (void *)userobj;
+		return true;
+	} else {
+		return false;  // Channel found, but, a handler is already registered!
 	}
-	return false;  // Channel not found in current bot configuration
 }
 
-boolean IrcBot::detachOnPart(const char *channel)
+boolean IrcBotBase::detachOnPart(const char *channel)
 {
 	int i;
 
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			if (channelPartCallbacks[i].callback != NULL) {
-				channelPartCallbacks[i].callback = NULL;
-				channelPartCallbacks[i].userobj = NULL;
-				return true;
-			} else {
-				return false;  // Channel found, but, no handler was registered.
-			}
-		}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
+	if (channelPartCallbacks[i].callback != NULL) {
+		channelPartCallbacks[i].callback = NULL;
+		channelPartCallbacks[i].userobj = NULL;
+		return true;
+	} else {
+		return false;  // Channel found, but, no handler was registered.
 	}
-	return false;  // Channel not found in current bot configuration
 }
 
-void IrcBot::executeOnChannelPartCallback(const int chanidx)
+void IrcBotBase::executeOnChannelPartCallback(const int chanidx)
 {
 	if (channelPartCallbacks[chanidx].callback != NULL) {
-		Dbg->print(">> Executing OnChannelPart callback for channel "); Dbg->println(_ircchannels[chanidx]);
+		if (IRC_LOGGING(IRC_LOG_DEBUG)) {
+			Dbg->print(">> Executing OnChannelPart callback for channel "); Dbg->println(_ircchannels[chanidx]);
+		}
 		channelPartCallbacks[chanidx].callback(channelPartCallbacks[chanidx].userobj, _ircchannels[chanidx]);
 	}
 }
 
 
 /* Callback handler maintenance - Channel Join/Part (Other arbitrary nicks) */
-boolean IrcBot::attachOnUserJoin(const char *channel, const char *nick, IRC_CALLBACK_TYPE_CHANNEL_USER callback, const void *userobj)
+boolean IrcBotBase::attachOnUserJoin(const char *channel, const char *nick, IRC_CALLBACK_TYPE_CHANNEL_USER callback, const void *userobj)
 {
 	int i, j, regidx;
 
 	// Find a slot in the ChanUserCallbackRegistry
-	for (regidx = 0; regidx < IRC_CALLBACK_MAX_CHANNELNICK; regidx++) {
+	for (regidx = 0; regidx < usercb_max; regidx++) {
 		if (channelUserJoinCallbacks[regidx].callback == NULL)
 			break;
 	}
-	if (regidx == IRC_CALLBACK_MAX_CHANNELNICK)
+	if (regidx == usercb_max)
 		return false;  // No more channel+nick callback registry slots!
 	
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			// We found a matching channel; re-search the registry to make sure this isn't a duplicate.
-			for (j=0; j < IRC_CALLBACK_MAX_CHANNELNICK; j++) {
-				if (channelUserJoinCallbacks[j].callback != NULL &&
-					channelUserJoinCallbacks[j].chanidx == i &&
-					channelUserJoinCallbacks[j].nick[0] != '\0' &&
-					!strncmp(channelUserJoinCallbacks[j].nick, nick, IRC_NICKUSER_MAXLEN))
-					return false;  // This channel+nick combination has already been registered!
-			}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
 
-			// All clear; go ahead and register.
-			channelUserJoinCallbacks[regidx].callback = callback;
-			channelUserJoinCallbacks[regidx].chanidx = i;
-			strncpy(channelUserJoinCallbacks[regidx].nick, nick, IRC_NICKUSER_MAXLEN-1);
-			channelUserJoinCallbacks[regidx].userobj = (void *)userobj;
-			return true;
-		}
+	// Make sure this channel+nick combination isn't a duplicate.
+	for (j=0; j < usercb_max; j++) {
+		if (channelUserJoinCallbacks[j].callback != NULL &&
+			channelUserJoinCallbacks[j].chanidx == i &&
+			channelUserJoinCallbacks[j].nick[0] != '\0' &&
+			caseEqual(channelUserJoinCallbacks[j].nick, nick))
+			return false;  // This channel+nick combination has already been registered!
 	}
-	return false;  // Channel not found in current bot configuration
+
+	// All clear; go ahead and register.
+	channelUserJoinCallbacks[regidx].callback = callback;
+	channelUserJoinCallbacks[regidx].chanidx = i;
+	strncpy(channelUserJoinCallbacks[regidx].nick, nick, IRC_NICKUSER_MAXLEN-1);
+	channelUserJoinCallbacks[regidx].userobj = (void *)userobj;
+	return true;
 }
 
-boolean IrcBot::detachOnUserJoin(const char *channel, const char *nick)
+boolean IrcBotBase::detachOnUserJoin(const char *channel, const char *nick)
 {
 	int i, j;
 
-	// Find the channel in the bot's channel registry
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(_ircchannels[i], channel, IRC_CHANNEL_MAXLEN))
-			break;
-	}
-	if (i == IRC_CHANNEL_MAX)
+	i = channelLookup(channel);
+	if (i < 0)
 		return false;  // Channel not found in current bot configuration
 	
-	for (j=0; j < IRC_CALLBACK_MAX_CHANNELNICK; j++) {
+	for (j=0; j < usercb_max; j++) {
 		if (channelUserJoinCallbacks[j].callback != NULL &&
 			channelUserJoinCallbacks[j].chanidx == i &&
-			!strncmp(channelUserJoinCallbacks[j].nick, nick, IRC_NICKUSER_MAXLEN)) {
+			caseEqual(channelUserJoinCallbacks[j].nick, nick)) {
 			channelUserJoinCallbacks[j].callback = NULL;
 			channelUserJoinCallbacks[j].chanidx = -1;
 			channelUserJoinCallbacks[j].userobj = NULL;
@@ -1255,56 +3518,51 @@ boolean IrcBot::detachOnUserJoin(const char *channel, const char *nick)
 	return false;  // Channel+Nick combination not found in registry
 }
 
-boolean IrcBot::attachOnUserPart(const char *channel, const char *nick, IRC_CALLBACK_TYPE_CHANNEL_USER callback, const void *userobj)
+boolean IrcBotBase::attachOnUserPart(const char *channel, const char *nick, IRC_CALLBACK_TYPE_CHANNEL_USER callback, const void *userobj)
 {
 	int i, j, regidx;
 
 	// Find a slot in the ChanUserCallbackRegistry
-	for (regidx = 0; regidx < IRC_CALLBACK_MAX_CHANNELNICK; regidx++) {
+	for (regidx = 0; regidx < usercb_max; regidx++) {
 		if (channelUserPartCallbacks[regidx].callback == NULL)
 			break;
 	}
-	if (regidx == IRC_CALLBACK_MAX_CHANNELNICK)
+	if (regidx == usercb_max)
 		return false;  // No more channel+nick callback registry slots!
 	
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(channel, _ircchannels[i], IRC_CHANNEL_MAXLEN)) {
-			// We found a matching channel; re-search the registry to make sure this isn't a duplicate.
-			for (j=0; j < IRC_CALLBACK_MAX_CHANNELNICK; j++) {
-				if (channelUserPartCallbacks[j].callback != NULL &&
-					channelUserPartCallbacks[j].chanidx == i &&
-					channelUserPartCallbacks[j].nick[0] != '\0' &&
-					!strncmp(channelUserPartCallbacks[j].nick, nick, IRC_NICKUSER_MAXLEN))
-					return false;  // This channel+nick combination has already been registered!
-			}
+	i = channelLookup(channel);
+	if (i < 0)
+		return false;  // Channel not found in current bot configuration
 
-			// All clear; go ahead and register.
-			channelUserPartCallbacks[regidx].callback = callback;
-			channelUserPartCallbacks[regidx].chanidx = i;
-			strncpy(channelUserPartCallbacks[regidx].nick, nick, IRC_NICKUSER_MAXLEN-1);
-			channelUserPartCallbacks[regidx].userobj = (void *)userobj;
-			return true;
-		}
+	// Make sure this channel+nick combination isn't a duplicate.
+	for (j=0; j < usercb_max; j++) {
+		if (channelUserPartCallbacks[j].callback != NULL &&
+			channelUserPartCallbacks[j].chanidx == i &&
+			channelUserPartCallbacks[j].nick[0] != '\0' &&
+			caseEqual(channelUserPartCallbacks[j].nick, nick))
+			return false;  // This channel+nick combination has already been registered!
 	}
-	return false;  // Channel not found in current bot configuration
+
+	// All clear; go ahead and register.
+	channelUserPartCallbacks[regidx].callback = callback;
+	channelUserPartCallbacks[regidx].chanidx = i;
+	strncpy(channelUserPartCallbacks[regidx].nick, nick, IRC_NICKUSER_MAXLEN-1);
+	channelUserPartCallbacks[regidx].userobj = (void *)userobj;
+	return true;
 }
 
-boolean IrcBot::detachOnUserPart(const char *channel, const char *nick)
+boolean IrcBotBase::detachOnUserPart(const char *channel, const char *nick)
 {
 	int i, j;
 
-	// Find the channel in the bot's channel registry
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(_ircchannels[i], channel, IRC_CHANNEL_MAXLEN))
-			break;
-	}
-	if (i == IRC_CHANNEL_MAX)
+	i = channelLookup(channel);
+	if (i < 0)
 		return false;  // Channel not found in current bot configuration
 	
-	for (j=0; j < IRC_CALLBACK_MAX_CHANNELNICK; j++) {
+	for (j=0; j < usercb_max; j++) {
 		if (channelUserPartCallbacks[j].callback != NULL &&
 			channelUserPartCallbacks[j].chanidx == i &&
-			!strncmp(channelUserPartCallbacks[j].nick, nick, IRC_NICKUSER_MAXLEN)) {
+			caseEqual(channelUserPartCallbacks[j].nick, nick)) {
 			channelUserPartCallbacks[j].callback = NULL;
 			channelUserPartCallbacks[j].chanidx = -1;
 			channelUserPartCallbacks[j].userobj = NULL;
@@ -1316,14 +3574,14 @@ boolean IrcBot::detachOnUserPart(const char *channel, const char *nick)
 }
 
 
-boolean IrcBot::flushUserJoinOrPartByChanIdx(const int chanidx)
+boolean IrcBotBase::flushUserJoinOrPartByChanIdx(const int chanidx)
 {
 	int j;
 
-	if (chanidx < 0 || chanidx >= IRC_CHANNEL_MAX)
+	if (chanidx < 0 || chanidx >= chan_max)
 		return false;
 
-	for (j=0; j < IRC_CALLBACK_MAX_CHANNELNICK; j++) {
+	for (j=0; j < usercb_max; j++) {
 		if (channelUserPartCallbacks[j].callback != NULL &&
 			channelUserPartCallbacks[j].chanidx == chanidx) {
 
@@ -1345,16 +3603,12 @@ boolean IrcBot::flushUserJoinOrPartByChanIdx(const int chanidx)
 	return true;
 }
 
-boolean IrcBot::flushUserJoinOrPart(const char *channel)
+boolean IrcBotBase::flushUserJoinOrPart(const char *channel)
 {
-	int i, j;
+	int i;
 
-	// Find the channel in the bot's channel registry
-	for (i=0; i < IRC_CHANNEL_MAX; i++) {
-		if (_ircchannels[i][0] != '\0' && !strncmp(_ircchannels[i], channel, IRC_CHANNEL_MAXLEN))
-			break;
-	}
-	if (i == IRC_CHANNEL_MAX)
+	i = channelLookup(channel);
+	if (i < 0)
 		return false;  // Channel not found in current bot configuration
 
 	return flushUserJoinOrPartByChanIdx(i);
@@ -1363,10 +3617,10 @@ boolean IrcBot::flushUserJoinOrPart(const char *channel)
 
 
 // Parse IRC User specification e.g. Nick!~Username@Hostname into their disparate components.
-boolean IrcBot::parseUserHostString(const void *str, char *nick, char *user, char *host)
+boolean IrcBotBase::parseUserHostString(const void *str, char *nick, char *user, char *host)
 {
 	const char *cstr = (const char *)str;
-	char *arg0, *arg1, *arg2, *arg3;
+	char *arg0, *arg1, *arg2;
 
 	if (str == NULL)
 		return false;
@@ -1402,32 +3656,93 @@ boolean IrcBot::parseUserHostString(const void *str, char *nick, char *user, cha
 }
 
 
-int IrcBot::ircProtocolCommandToken(const char *cmd)
+/* Command verbs of up to 8 characters are packed into a 64-bit integer so the lookup below is a single
+ * switch (a handful of compares or a jump table) instead of a strcmp() per known verb.
+ */
+static constexpr uint64_t ircVerbKey(const char *verb, const unsigned int i = 0, const uint64_t key = 0)
+{
+	return (i == 8 || verb[i] == '\0') ? key : ircVerbKey(verb, i+1, (key << 8) | (uint8_t)verb[i]);
+}
+
+int IrcBotBase::ircProtocolCommandToken(const char *cmd)
 {
+	uint64_t key = 0;
+	unsigned int i;
+
 	if (cmd[0] >= '0' && cmd[0] <= '9') {  // Numeric reply code
-		return atoi(cmd);
-	} else {
-		if (!strcmp(cmd, "PRIVMSG")) return IRC_CMDTOKEN_PRIVMSG;
-		if (!strcmp(cmd, "NOTICE")) return IRC_CMDTOKEN_NOTICE;
-		if (!strcmp(cmd, "PASS")) return IRC_CMDTOKEN_PASS;
-		if (!strcmp(cmd, "NICK")) return IRC_CMDTOKEN_NICK;
-		if (!strcmp(cmd, "USER")) return IRC_CMDTOKEN_USER;
-		if (!strcmp(cmd, "OPER")) return IRC_CMDTOKEN_OPER;
-		if (!strcmp(cmd, "MODE")) return IRC_CMDTOKEN_MODE;
-		if (!strcmp(cmd, "SERVICE")) return IRC_CMDTOKEN_SERVICE;
-		if (!strcmp(cmd, "QUIT")) return IRC_CMDTOKEN_QUIT;
-		if (!strcmp(cmd, "JOIN")) return IRC_CMDTOKEN_JOIN;
-		if (!strcmp(cmd, "PART")) return IRC_CMDTOKEN_PART;
-		if (!strcmp(cmd, "TOPIC")) return IRC_CMDTOKEN_TOPIC;
-		if (!strcmp(cmd, "INVITE")) return IRC_CMDTOKEN_INVITE;
-		if (!strcmp(cmd, "KICK")) return IRC_CMDTOKEN_KICK;
-		if (!strcmp(cmd, "PING")) return IRC_CMDTOKEN_PING;
-		if (!strcmp(cmd, "PONG")) return IRC_CMDTOKEN_PONG;
+		if (cmd[1] < '0' || cmd[1] > '9' || cmd[2] < '0' || cmd[2] > '9' || cmd[3] != '\0')
+			return -1;
+		return (cmd[0]-'0')*100 + (cmd[1]-'0')*10 + (cmd[2]-'0');
+	}
+
+	for (i=0; i < 8 && cmd[i] != '\0'; i++)
+		key = (key << 8) | (uint8_t)cmd[i];
+	if (cmd[i] != '\0') {  // Only one verb is longer than 8 characters
+		if (!strcmp(cmd, "AUTHENTICATE"))
+			return IRC_CMDTOKEN_AUTHENTICATE;
+		return -1;
+	}
+
+	switch (key) {
+		case ircVerbKey("PRIVMSG"): return IRC_CMDTOKEN_PRIVMSG;
+		case ircVerbKey("NOTICE"): return IRC_CMDTOKEN_NOTICE;
+		case ircVerbKey("PASS"): return IRC_CMDTOKEN_PASS;
+		case ircVerbKey("NICK"): return IRC_CMDTOKEN_NICK;
+		case ircVerbKey("USER"): return IRC_CMDTOKEN_USER;
+		case ircVerbKey("OPER"): return IRC_CMDTOKEN_OPER;
+		case ircVerbKey("MODE"): return IRC_CMDTOKEN_MODE;
+		case ircVerbKey("SERVICE"): return IRC_CMDTOKEN_SERVICE;
+		case ircVerbKey("QUIT"): return IRC_CMDTOKEN_QUIT;
+		case ircVerbKey("JOIN"): return IRC_CMDTOKEN_JOIN;
+		case ircVerbKey("PART"): return IRC_CMDTOKEN_PART;
+		case ircVerbKey("TOPIC"): return IRC_CMDTOKEN_TOPIC;
+		case ircVerbKey("INVITE"): return IRC_CMDTOKEN_INVITE;
+		case ircVerbKey("KICK"): return IRC_CMDTOKEN_KICK;
+		case ircVerbKey("PING"): return IRC_CMDTOKEN_PING;
+		case ircVerbKey("PONG"): return IRC_CMDTOKEN_PONG;
+		case ircVerbKey("SQUIT"): return IRC_CMDTOKEN_SQUIT;
+		case ircVerbKey("NAMES"): return IRC_CMDTOKEN_NAMES;
+		case ircVerbKey("LIST"): return IRC_CMDTOKEN_LIST;
+		case ircVerbKey("MOTD"): return IRC_CMDTOKEN_MOTD;
+		case ircVerbKey("LUSERS"): return IRC_CMDTOKEN_LUSERS;
+		case ircVerbKey("VERSION"): return IRC_CMDTOKEN_VERSION;
+		case ircVerbKey("STATS"): return IRC_CMDTOKEN_STATS;
+		case ircVerbKey("LINKS"): return IRC_CMDTOKEN_LINKS;
+		case ircVerbKey("TIME"): return IRC_CMDTOKEN_TIME;
+		case ircVerbKey("CONNECT"): return IRC_CMDTOKEN_CONNECT;
+		case ircVerbKey("TRACE"): return IRC_CMDTOKEN_TRACE;
+		case ircVerbKey("ADMIN"): return IRC_CMDTOKEN_ADMIN;
+		case ircVerbKey("INFO"): return IRC_CMDTOKEN_INFO;
+		case ircVerbKey("SERVLIST"): return IRC_CMDTOKEN_SERVLIST;
+		case ircVerbKey("SQUERY"): return IRC_CMDTOKEN_SQUERY;
+		case ircVerbKey("WHO"): return IRC_CMDTOKEN_WHO;
+		case ircVerbKey("WHOIS"): return IRC_CMDTOKEN_WHOIS;
+		case ircVerbKey("WHOWAS"): return IRC_CMDTOKEN_WHOWAS;
+		case ircVerbKey("KILL"): return IRC_CMDTOKEN_KILL;
+		case ircVerbKey("ERROR"): return IRC_CMDTOKEN_ERROR;
+		case ircVerbKey("AWAY"): return IRC_CMDTOKEN_AWAY;
+		case ircVerbKey("REHASH"): return IRC_CMDTOKEN_REHASH;
+		case ircVerbKey("DIE"): return IRC_CMDTOKEN_DIE;
+		case ircVerbKey("RESTART"): return IRC_CMDTOKEN_RESTART;
+		case ircVerbKey("SUMMON"): return IRC_CMDTOKEN_SUMMON;
+		case ircVerbKey("USERS"): return IRC_CMDTOKEN_USERS;
+		case ircVerbKey("WALLOPS"): return IRC_CMDTOKEN_WALLOPS;
+		case ircVerbKey("USERHOST"): return IRC_CMDTOKEN_USERHOST;
+		case ircVerbKey("ISON"): return IRC_CMDTOKEN_ISON;
+		case ircVerbKey("CAP"): return IRC_CMDTOKEN_CAP;
+		case ircVerbKey("ACCOUNT"): return IRC_CMDTOKEN_ACCOUNT;
+		case ircVerbKey("BATCH"): return IRC_CMDTOKEN_BATCH;
+		case ircVerbKey("CHGHOST"): return IRC_CMDTOKEN_CHGHOST;
+		case ircVerbKey("SETNAME"): return IRC_CMDTOKEN_SETNAME;
+		case ircVerbKey("TAGMSG"): return IRC_CMDTOKEN_TAGMSG;
+		case ircVerbKey("FAIL"): return IRC_CMDTOKEN_FAIL;
+		case ircVerbKey("WARN"): return IRC_CMDTOKEN_WARN;
+		case ircVerbKey("NOTE"): return IRC_CMDTOKEN_NOTE;
 	}
 	return -1;
 }
 
-void IrcBot::argToken(char *buffer, CmdTok *ts)
+void IrcBotBase::argToken(char *buffer, CmdTok *ts)
 {
 	char c;
 
@@ -1452,125 +3767,220 @@ void IrcBot::argToken(char *buffer, CmdTok *ts)
 	return;
 }
 
-const IrcReplyCode ircReplyCodeDatabase[] = {
-	{901, "PRIVMSG"},
-	{902, "NOTICE"},
-	{903, "PASS"},
-	{904, "NICK"},
-	{905, "USER"},
-	{906, "OPER"},
-	{907, "MODE"},
-	{908, "SERVICE"},
-	{909, "QUIT"},
-	{910, "JOIN"},
-	{911, "PART"},
-	{912, "TOPIC"},
-	{913, "INVITE"},
-	{914, "KICK"},
-	{915, "PING"},
-	{916, "PONG"},
-	{1, "RPL_WELCOME"},
-	{2, "RPL_YOURHOST"},
-	{3, "RPL_CREATED"},
-	{4, "RPL_MYINFO"},
-	{5, "RPL_BOUNCE"},
-	{302, "RPL_USERHOST"},
-	{303, "RPL_ISON"},
-	{301, "RPL_AWAY"},
-	{305, "RPL_UNAWAY"},
-	{306, "RPL_NOWAWAY"},
-	{311, "RPL_WHOISUSER"},
-	{312, "RPL_WHOISSERVER"},
-	{313, "RPL_WHOISOPERATOR"},
-	{317, "RPL_WHOISIDLE"},
-	{318, "RPL_ENDOFWHOIS"},
-	{319, "RPL_WHOISCHANNELS"},
-	{314, "RPL_WHOWASUSER"},
-	{369, "RPL_ENDOFWHOWAS"},
-	{322, "RPL_LIST"},
-	{323, "RPL_LISTEND"},
-	{325, "RPL_UNIQOPIS"},
-	{324, "RPL_CHANNELMODEIS"},
-	{331, "RPL_NOTOPIC"},
-	{332, "RPL_TOPIC"},
-	{341, "RPL_INVITING"},
-	{346, "RPL_INVITELIST"},
-	{347, "RPL_ENDOFINVITELIST"},
-	{348, "RPL_EXCEPTLIST"},
-	{349, "RPL_ENDOFEXCEPTLIST"},
-	{351, "RPL_VERSION"},
-	{352, "RPL_WHOREPLY"},
-	{315, "RPL_ENDOFWHO"},
-	{353, "RPL_NAMREPLY"},
-	{366, "RPL_ENDOFNAMES"},
-	{367, "RPL_BANLIST"},
-	{368, "RPL_ENDOFBANLIST"},
-	{371, "RPL_INFO"},
-	{374, "RPL_ENDOFINFO"},
-	{375, "RPL_MOTDSTART"},
-	{372, "RPL_MOTD"},
-	{376, "RPL_ENDOFMOTD"},
-	{381, "RPL_YOUREOPER"},
-	{391, "RPL_TIME"},
-	{221, "RPL_UMODEIS"},
-	{263, "RPL_TRYAGAIN"},
-	{401, "ERR_NOSUCHNICK"},
-	{402, "ERR_NOSUCHSERVER"},
-	{403, "ERR_NOSUCHCHANNEL"},
-	{404, "ERR_CANNOTSENDTOCHAN"},
-	{405, "ERR_TOOMANYCHANNELS"},
-	{406, "ERR_WASNOSUCHNICK"},
-	{407, "ERR_TOOMANYTARGETS"},
-	{408, "ERR_NOSUCHSERVICE"},
-	{409, "ERR_NOORIGIN"},
-	{411, "ERR_NORECIPIENT"},
-	{412, "ERR_NOTEXTTOSEND"},
-	{413, "ERR_NOTOPLEVEL"},
-	{414, "ERR_WILDTOPLEVEL"},
-	{415, "ERR_BADMASK"},
-	{421, "ERR_UNKNOWNCOMMAND"},
-	{422, "ERR_NOMOTD"},
-	{431, "ERR_NONICKNAMEGIVEN"},
-	{432, "ERR_ERRONEOUSNICKNAME"},
-	{433, "ERR_NICKNAMEINUSE"},
-	{436, "ERR_NICKCOLLISION"},
-	{437, "ERR_UNAVAILRESOURCE"},
-	{441, "ERR_USERNOTINCHANNEL"},
-	{442, "ERR_NOTONCHANNEL"},
-	{443, "ERR_USERONCHANNEL"},
-	{451, "ERR_NOTREGISTERED"},
-	{461, "ERR_NEEDMOREPARAMS"},
-	{462, "ERR_ALREADYREGISTERED"},
-	{463, "ERR_NOPERMFORHOST"},
-	{464, "ERR_PASSWDMISMATCH"},
-	{465, "ERR_YOUREBANNEDCREEP"},
-	{466, "ERR_YOUWILLBEBANNED"},
-	{467, "ERR_KEYSET"},
-	{471, "ERR_CHANNELISFULL"},
-	{472, "ERR_UNKNOWNMODE"},
-	{473, "ERR_INVITEONLYCHAN"},
-	{474, "ERR_BANNEDFROMCHAN"},
-	{475, "ERR_BADCHANNELKEY"},
-	{476, "ERR_BADCHANMASK"},
-	{477, "ERR_NOCHANMODES"},
-	{478, "ERR_BANLISTFULL"},
-	{481, "ERR_NOPRIVILEGES"},
-	{482, "ERR_CHANOPRIVSNEEDED"},
-	{484, "ERR_RESTRICTED"},
-	{485, "ERR_UNIQOPPRIVSNEEDED"},
-	{501, "ERR_UMODEUNKNOWNFLAG"},
-	{502, "ERR_USERSDONTMATCH"},
-	{0, NULL}
+/* Reply codes and command verbs: name, which handler acts on them and how they're routed.
+ * Lives in flash; looked up through the direct index generated below.
+ */
+static constexpr IrcReplyCode ircReplyCodeDatabase[] = {
+	{IRC_CMDTOKEN_PRIVMSG, "PRIVMSG", IRC_HANDLER_PRIVMSG, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_NOTICE, "NOTICE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_PASS, "PASS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_NICK, "NICK", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_USER, "USER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_OPER, "OPER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_MODE, "MODE", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_SERVICE, "SERVICE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_QUIT, "QUIT", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_JOIN, "JOIN", IRC_HANDLER_JOINPART, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_PART, "PART", IRC_HANDLER_JOINPART, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_TOPIC, "TOPIC", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_INVITE, "INVITE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_KICK, "KICK", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_PING, "PING", IRC_HANDLER_PING, IRC_REPLY_HANDLED},
+	{IRC_CMDTOKEN_PONG, "PONG", IRC_HANDLER_PONG, IRC_REPLY_HANDLED},
+	{IRC_CMDTOKEN_SQUIT, "SQUIT", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_NAMES, "NAMES", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_LIST, "LIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_MOTD, "MOTD", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_LUSERS, "LUSERS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_VERSION, "VERSION", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_STATS, "STATS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_LINKS, "LINKS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_TIME, "TIME", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_CONNECT, "CONNECT", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_TRACE, "TRACE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_ADMIN, "ADMIN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_INFO, "INFO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_SERVLIST, "SERVLIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_SQUERY, "SQUERY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_WHO, "WHO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_WHOIS, "WHOIS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_WHOWAS, "WHOWAS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_KILL, "KILL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_ERROR, "ERROR", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_AWAY, "AWAY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_REHASH, "REHASH", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_DIE, "DIE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_RESTART, "RESTART", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_SUMMON, "SUMMON", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_USERS, "USERS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_WALLOPS, "WALLOPS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_USERHOST, "USERHOST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_ISON, "ISON", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_CAP, "CAP", IRC_HANDLER_CAP, IRC_REPLY_HANDLED},
+	{IRC_CMDTOKEN_AUTHENTICATE, "AUTHENTICATE", IRC_HANDLER_SASL, IRC_REPLY_HANDLED},
+	{IRC_CMDTOKEN_ACCOUNT, "ACCOUNT", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_BATCH, "BATCH", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_CHGHOST, "CHGHOST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_SETNAME, "SETNAME", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_TAGMSG, "TAGMSG", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_FAIL, "FAIL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_WARN, "WARN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{IRC_CMDTOKEN_NOTE, "NOTE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{1, "RPL_WELCOME", IRC_HANDLER_WELCOME, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{2, "RPL_YOURHOST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{3, "RPL_CREATED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{4, "RPL_MYINFO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{5, "RPL_ISUPPORT", IRC_HANDLER_ISUPPORT, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{302, "RPL_USERHOST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{303, "RPL_ISON", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{301, "RPL_AWAY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{305, "RPL_UNAWAY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{306, "RPL_NOWAWAY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{311, "RPL_WHOISUSER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{312, "RPL_WHOISSERVER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{313, "RPL_WHOISOPERATOR", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{317, "RPL_WHOISIDLE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{318, "RPL_ENDOFWHOIS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{319, "RPL_WHOISCHANNELS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{314, "RPL_WHOWASUSER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{369, "RPL_ENDOFWHOWAS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{322, "RPL_LIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{323, "RPL_LISTEND", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{325, "RPL_UNIQOPIS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{324, "RPL_CHANNELMODEIS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{331, "RPL_NOTOPIC", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{332, "RPL_TOPIC", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{341, "RPL_INVITING", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{346, "RPL_INVITELIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{347, "RPL_ENDOFINVITELIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{348, "RPL_EXCEPTLIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{349, "RPL_ENDOFEXCEPTLIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{351, "RPL_VERSION", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{352, "RPL_WHOREPLY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{315, "RPL_ENDOFWHO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{353, "RPL_NAMREPLY", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{366, "RPL_ENDOFNAMES", IRC_HANDLER_MEMBERSHIP, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{367, "RPL_BANLIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{368, "RPL_ENDOFBANLIST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{371, "RPL_INFO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{374, "RPL_ENDOFINFO", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{375, "RPL_MOTDSTART", IRC_HANDLER_NONE, 0},
+	{372, "RPL_MOTD", IRC_HANDLER_NONE, 0},
+	{376, "RPL_ENDOFMOTD", IRC_HANDLER_ENDOFMOTD, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{381, "RPL_YOUREOPER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{391, "RPL_TIME", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{221, "RPL_UMODEIS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{263, "RPL_TRYAGAIN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{401, "ERR_NOSUCHNICK", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{402, "ERR_NOSUCHSERVER", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{403, "ERR_NOSUCHCHANNEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{404, "ERR_CANNOTSENDTOCHAN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{405, "ERR_TOOMANYCHANNELS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{406, "ERR_WASNOSUCHNICK", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{407, "ERR_TOOMANYTARGETS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{408, "ERR_NOSUCHSERVICE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{409, "ERR_NOORIGIN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{411, "ERR_NORECIPIENT", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{412, "ERR_NOTEXTTOSEND", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{413, "ERR_NOTOPLEVEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{414, "ERR_WILDTOPLEVEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{415, "ERR_BADMASK", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{421, "ERR_UNKNOWNCOMMAND", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{422, "ERR_NOMOTD", IRC_HANDLER_ENDOFMOTD, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{431, "ERR_NONICKNAMEGIVEN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{432, "ERR_ERRONEOUSNICKNAME", IRC_HANDLER_NICKERROR, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{433, "ERR_NICKNAMEINUSE", IRC_HANDLER_NICKERROR, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{436, "ERR_NICKCOLLISION", IRC_HANDLER_NICKERROR, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{437, "ERR_UNAVAILRESOURCE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{441, "ERR_USERNOTINCHANNEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{442, "ERR_NOTONCHANNEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{443, "ERR_USERONCHANNEL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{451, "ERR_NOTREGISTERED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{461, "ERR_NEEDMOREPARAMS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{462, "ERR_ALREADYREGISTERED", IRC_HANDLER_WELCOME, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{463, "ERR_NOPERMFORHOST", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{464, "ERR_PASSWDMISMATCH", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{465, "ERR_YOUREBANNEDCREEP", IRC_HANDLER_BANNED, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{466, "ERR_YOUWILLBEBANNED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{467, "ERR_KEYSET", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{471, "ERR_CHANNELISFULL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{472, "ERR_UNKNOWNMODE", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{473, "ERR_INVITEONLYCHAN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{474, "ERR_BANNEDFROMCHAN", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{475, "ERR_BADCHANNELKEY", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{476, "ERR_BADCHANMASK", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{477, "ERR_NOCHANMODES", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{478, "ERR_BANLISTFULL", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{481, "ERR_NOPRIVILEGES", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{482, "ERR_CHANOPRIVSNEEDED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{484, "ERR_RESTRICTED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{485, "ERR_UNIQOPPRIVSNEEDED", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{501, "ERR_UMODEUNKNOWNFLAG", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{502, "ERR_USERSDONTMATCH", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{900, "RPL_LOGGEDIN", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{901, "RPL_LOGGEDOUT", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{902, "ERR_NICKLOCKED", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{903, "RPL_SASLSUCCESS", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{904, "ERR_SASLFAIL", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{905, "ERR_SASLTOOLONG", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{906, "ERR_SASLABORTED", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{907, "ERR_SASLALREADY", IRC_HANDLER_SASL, IRC_REPLY_HANDLED|IRC_REPLY_FORWARD},
+	{908, "RPL_SASLMECHS", IRC_HANDLER_NONE, IRC_REPLY_FORWARD},
+	{0, NULL, IRC_HANDLER_NONE, 0}
 };
 
-const char *IrcBot::ircReplyCodeStrerror(unsigned int cmdtoken)
+/* Direct index from cmdtoken (0 through IRC_CMDTOKEN_VERB_LAST) to its ircReplyCodeDatabase entry,
+ * built at compile time so it is a const table in flash rather than a search at runtime.
+ * IrcIndexSeq<0..N-1> is generated by halving so template nesting stays shallow.
+ */
+#define IRC_REPLYCODE_NONE 0xFF
+
+static constexpr uint8_t ircReplyCodeFind(const unsigned int code, const unsigned int i = 0)
 {
-	int i = 0;
+	return (ircReplyCodeDatabase[i].description == NULL) ? IRC_REPLYCODE_NONE :
+		(ircReplyCodeDatabase[i].code == code) ? i : ircReplyCodeFind(code, i+1);
+}
 
-	while (ircReplyCodeDatabase[i].description != NULL) {
-		if (cmdtoken == ircReplyCodeDatabase[i].code)
-			return ircReplyCodeDatabase[i].description;
-		i++;
-	}
-	return "(not found)";
+template<unsigned int... I> struct IrcIndexSeq {};
+
+template<class A, class B> struct IrcIndexSeqCat;
+template<unsigned int... A, unsigned int... B> struct IrcIndexSeqCat< IrcIndexSeq<A...>, IrcIndexSeq<B...> > {
+	typedef IrcIndexSeq<A..., (sizeof...(A) + B)...> type;
+};
+
+template<unsigned int N> struct IrcMakeIndexSeq {
+	typedef typename IrcIndexSeqCat< typename IrcMakeIndexSeq<N/2>::type, typename IrcMakeIndexSeq<N - N/2>::type >::type type;
+};
+template<> struct IrcMakeIndexSeq<0> { typedef IrcIndexSeq<> type; };
+template<> struct IrcMakeIndexSeq<1> { typedef IrcIndexSeq<0> type; };
+
+template<class S> struct IrcReplyCodeIndex;
+template<unsigned int... I> struct IrcReplyCodeIndex< IrcIndexSeq<I...> > {
+	static const uint8_t table[sizeof...(I)];
+};
+template<unsigned int... I> const uint8_t IrcReplyCodeIndex< IrcIndexSeq<I...> >::table[sizeof...(I)] = { ircReplyCodeFind(I)... };
+
+typedef IrcReplyCodeIndex< IrcMakeIndexSeq<IRC_CMDTOKEN_VERB_LAST+1>::type > IrcReplyCodeTable;
+
+static_assert(sizeof(ircReplyCodeDatabase) / sizeof(ircReplyCodeDatabase[0]) < IRC_REPLYCODE_NONE, "ircReplyCodeDatabase too large for a uint8_t index");
+
+const IrcReplyCode *IrcBotBase::ircReplyCodeLookup(const int cmdtoken)
+{
+	uint8_t i;
+
+	if (cmdtoken < 0 || cmdtoken > IRC_CMDTOKEN_VERB_LAST)
+		return NULL;
+	i = IrcReplyCodeTable::table[cmdtoken];
+	if (i == IRC_REPLYCODE_NONE)
+		return NULL;
+	return &ircReplyCodeDatabase[i];
+}
+
+const char *IrcBotBase::ircReplyCodeStrerror(unsigned int cmdtoken)
+{
+	const IrcReplyCode *rc = ircReplyCodeLookup(cmdtoken);
+
+	if (rc == NULL)
+		return "(not found)";
+	return rc->description;
 }
@@ -19,39 +19,146 @@
 #ifndef IRCBOT_H
 #define IRCBOT_H
 
+#if __cplusplus < 201103L
+#error "IrcBot requires C++11 (-std=gnu++11)"
+#endif
+
+#if defined(ENERGIA) || defined(ARDUINO)
 #include <Energia.h>
+#else
+#include "IrcBotHost.h"  // Building on a Linux host
+#endif
 #include <inttypes.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
+/* IRC_NETWORK_RESOLVE(host, ip) looks up the server's address (returning 1 on success) so it can be cached
+ * between reconnects.  IRC_NETWORK_ASYNC_CONNECT is defined when the client class has connectAsync() and
+ * connectPoll(); without it, connect() still blocks for the TCP handshake (but no longer for DNS).
+ */
 //#define IRC_NETWORK_CLIENT_CLASS WiFiClient
+//#define IRC_NETWORK_RESOLVE(host, ip) WiFi.hostByName(host, ip)
 //#include <WiFi.h>
 //#include <WiFiClient.h>
 
+#if defined(ENERGIA) || defined(ARDUINO)
 #define IRC_NETWORK_CLIENT_CLASS EthernetClient
+#define IRC_NETWORK_RESOLVE(host, ip) ircDnsResolve(host, ip)
+#define IRC_NETWORK_DNSCLIENT
 #include <Ethernet.h>
 #include <EthernetClient.h>
+#else
+#define IRC_NETWORK_CLIENT_CLASS PosixClient
+#define IRC_NETWORK_RESOLVE(host, ip) PosixClient::resolve(host, ip)
+#define IRC_NETWORK_ASYNC_CONNECT
+#include "PosixClient.h"
+#endif
 
 
 
-#define IRC_CHANNEL_MAX 4
+/* Table sizes marked * are defaults for IrcBot; BasicIrcBot<Config> sizes each instance on its own
+ * (see IrcBotConfig).  The rest apply to every instance.
+ */
+#define IRC_CHANNEL_MAX 4  // * Lookups are hashed, so this can be raised freely (up to 65534)
 #define IRC_CHANNEL_MAXLEN 32
-#define IRC_CALLBACK_MAX_CHANNELNICK 64
-#define IRC_COMMAND_REGISTRY_MAX 32
+#define IRC_CHANKEY_MAXLEN 24
+#define IRC_CALLBACK_MAX_CHANNELNICK 64  // *
+#define IRC_COMMAND_REGISTRY_MAX 32  // * Lookups are hashed, so this can be raised freely (up to 65534)
 #define IRC_SERVERNAME_MAXLEN 64
 #define IRC_NICKUSER_MAXLEN 32
+#define IRC_PASSWORD_MAXLEN 64
+#define IRC_SASL_ACCOUNT_MAXLEN 32
+#define IRC_NICK_RETRY_MAX 8  // Alternate nicks tried during registration before giving up on the connection
 #define IRC_DESCRIPTION_MAXLEN 128
-#define IRC_INGRESS_BUFFER_LEN 512
-#define IRC_INGRESS_RINGBUF_LEN 1024
+#define IRC_INGRESS_RINGBUF_LEN 1024  // *
+#define IRC_INGRESS_LINE_MAX 512    // Longer lines are counted and skipped up to their terminator
+#define IRC_INGRESS_PASS_MAX 4096   // Bytes loop() will read and process in one pass while more keeps arriving
+#define IRC_EGRESS_LINE_MAX 512     // Longest line we send, including \r\n; longer messages are split
+#define IRC_HOSTNAME_MAXLEN 63      // Assumed length of our host as others see it, until our own JOIN shows it
+#define IRC_EGRESS_BUFFER_LEN 1024  // * Outbound lines are assembled here and written together
+#define IRC_EGRESS_QUEUE_LINES 16   // * Lines that can wait on flood control before new ones are dropped
+#define IRC_EGRESS_QUEUE_LEN 2048   // * Bytes of storage for those waiting lines
+
+#define IRC_POLL_IDLE 0xFFFFFFFFUL
+#define IRC_CONNECT_TIMEOUT 10000      // ms allowed for the TCP handshake
+
+// Default reconnect policy; see IrcReconnectPolicy
+#define IRC_RECONNECT_INITIAL 2000
+#define IRC_RECONNECT_MAX 300000UL
+#define IRC_RECONNECT_JITTER 50
+#define IRC_RECONNECT_STABLE 60000UL
+#define IRC_DNS_CACHE_TTL 3600000UL    // ms a resolved server address is reused before looking it up again
+
+// Default outbound flood control; see setFloodControl()
+#define IRC_FLOOD_BURST_LINES 5
+#define IRC_FLOOD_MS_PER_LINE 1000
+#define IRC_FLOOD_BYTES_PER_SEC 1024
+/* * Channel membership tracking (isOnChannel() and friends).  Each nick we share a channel with takes
+ * one Nicks entry however many channels they're in, plus one Members entry per channel.  A plain IrcBot
+ * gets IRC_MEMBERS_DEFAULT entries (none); a bot that wants tracking sets Members and Nicks in its config.
+ * IRC_MEMBERS_MAX 0 leaves the tracking code out of the build altogether.
+ */
+#ifndef IRC_MEMBERS_MAX
+#if defined(ENERGIA) || defined(ARDUINO)
+#define IRC_MEMBERS_MAX 0
+#else
+#define IRC_MEMBERS_MAX 4096
+#endif
+#endif
+#ifndef IRC_NICKS_MAX
+#define IRC_NICKS_MAX (IRC_MEMBERS_MAX / 2)
+#endif
+#ifndef IRC_MEMBERS_DEFAULT
+#define IRC_MEMBERS_DEFAULT 0
+#endif
+
+#define IRC_MESSAGE_PARAMS_MAX 15
+#define IRC_MESSAGE_TAGS_MAX 8  // IRCv3 message tags kept per line; any past this are ignored
 #define IRC_CMDTOK_MAX 16
 
+/* Debug logging levels.  Messages above IRC_LOG_LEVEL are compiled out entirely (code and strings);
+ * the rest can be filtered further at runtime with setLogLevel().  setDebug() selects the output Stream.
+ */
+#define IRC_LOG_NONE 0
+#define IRC_LOG_ERROR 1
+#define IRC_LOG_WARN 2
+#define IRC_LOG_INFO 3   // Connection & channel state changes
+#define IRC_LOG_DEBUG 4  // Callbacks, outgoing messages
+#define IRC_LOG_TRACE 5  // Every line received & how it was parsed
+
+#ifndef IRC_LOG_LEVEL
+#define IRC_LOG_LEVEL IRC_LOG_INFO
+#endif
+
+#define IRC_LOGGING(level) ((level) <= IRC_LOG_LEVEL && (level) <= _loglevel && Dbg != NULL)
+
 typedef void(*IRC_CALLBACK_TYPE_CONNECT)(void *userobj);
 typedef void(*IRC_CALLBACK_TYPE_CHANNEL)(void *userobj, const char *channel);
 typedef void(*IRC_CALLBACK_TYPE_CHANNEL_USER)(void *userobj, const char *channel, const char *nick);
 typedef void(*IRC_CALLBACK_TYPE_COMMAND)(void *userobj, const char *channel, const char *fromnick, const char *message);
+typedef void(*IRC_CALLBACK_TYPE_RECONNECT)(void *userobj, unsigned int attempt, uint32_t delay);
+// One NAMES entry: modes as in getMemberModes(); nick is NULL once the channel's list is complete
+typedef void(*IRC_CALLBACK_TYPE_NAMES)(void *userobj, const char *channel, const char *nick, uint8_t modes);
+
+/* Reconnect pacing.  The wait before attempt n is initialDelay * 2^(n-1), capped at maxDelay, then
+ * shortened by a random amount of up to jitterPercent so a fleet of bots doesn't come back in lockstep.
+ * A connection which stays registered for stableTime ms resets the count.
+ */
+typedef struct {
+	uint32_t initialDelay;
+	uint32_t maxDelay;
+	uint8_t jitterPercent;
+	uint32_t stableTime;
+} IrcReconnectPolicy;
 
 typedef struct {
 	char *cmd;
+	uint16_t hash;
 	IRC_CALLBACK_TYPE_COMMAND callback;
 	IRC_CALLBACK_TYPE_COMMAND unauth_callback;
 	void *userobj;
@@ -70,6 +177,137 @@ typedef struct {
 	void *userobj;
 } ChanUserCallbackRegistry;
 
+// One IRCv3 message tag; both strings point into the receive buffer.  value is "" for a tag without one.
+typedef struct {
+	char *key;
+	char *value;
+} IrcMessageTag;
+
+/* A parsed protocol line.  Every field points into the receive buffer (the line is split in place
+ * by writing NULs over its delimiters); valid only for the duration of processing that line.
+ */
+typedef struct {
+	char *nick;      // Message source: nick (or servername) portion of the prefix, NULL if none
+	char *user;      // User portion of the prefix, NULL if absent
+	char *host;      // Host portion of the prefix, NULL if absent
+	char *command;   // Command verb or 3-digit reply code
+	int cmdtoken;    // IRC_CMDTOKEN_* value of command
+	int paramc;
+	char *params[IRC_MESSAGE_PARAMS_MAX];  // Includes the trailing parameter as the last entry
+	char *trailing;  // Trailing (":"-prefixed) parameter or NULL
+	int tagc;
+	IrcMessageTag tags[IRC_MESSAGE_TAGS_MAX];  // "@key=value;..." tags, values unescaped
+} IrcMessage;
+
+// Value of the named tag on msg, or NULL if it has none
+const char *ircMessageTag(const IrcMessage *msg, const char *key);
+
+/* IRCv3 capabilities the bot can request during registration (see setCapabilities()).
+ * The bot itself only needs the parser to understand tags; what to do with them is up to the sketch.
+ */
+#define IRC_CAP_SERVER_TIME  0x0001
+#define IRC_CAP_ACCOUNT_TAG  0x0002
+#define IRC_CAP_BATCH        0x0004
+#define IRC_CAP_ECHO_MESSAGE 0x0008
+#define IRC_CAP_MESSAGE_TAGS 0x0010
+#define IRC_CAP_SASL         0x0020  // Requested automatically when setSasl() names a mechanism
+#define IRC_CAP_COUNT 6
+
+// SASL mechanisms for setSasl()
+#define IRC_SASL_NONE     0
+#define IRC_SASL_PLAIN    1  // Account name and password
+#define IRC_SASL_EXTERNAL 2  // Client certificate presented by the transport
+
+// getSaslStatus() values
+#define IRC_SASL_IDLE     0  // Not attempted on this connection
+#define IRC_SASL_PENDING  1
+#define IRC_SASL_SUCCESS  2
+#define IRC_SASL_FAILED   3  // Registration carried on without logging in
+
+/* Server limits and conventions from RPL_ISUPPORT (005).  Reset to RFC1459 defaults on every
+ * connection and updated as the 005 lines arrive after the welcome.
+ */
+#define IRC_ISUPPORT_CHANTYPES_MAX 8
+#define IRC_ISUPPORT_PREFIX_MAX 8
+#define IRC_ISUPPORT_CHANMODES_MAX 24
+#define IRC_TARGETS_UNLIMITED 0xFF
+
+#define IRC_CASEMAP_ASCII          0
+#define IRC_CASEMAP_RFC1459        1  // Also folds []\~ to {}|^
+#define IRC_CASEMAP_STRICT_RFC1459 2  // []\ to {}| only
+
+typedef struct {
+	uint16_t linelen;         // LINELEN including \r\n, capped at IRC_EGRESS_LINE_MAX
+	uint8_t nicklen;          // NICKLEN
+	uint8_t channellen;       // CHANNELLEN
+	uint8_t maxtargets;       // MAXTARGETS; 0 = not advertised
+	uint8_t targmax_privmsg;  // TARGMAX entries for the commands we send; 0 = not advertised
+	uint8_t targmax_notice;
+	uint8_t targmax_join;
+	uint8_t casemapping;      // IRC_CASEMAP_*
+	char chantypes[IRC_ISUPPORT_CHANTYPES_MAX+1];        // CHANTYPES, e.g. "#&"
+	char chanlimit_types[IRC_ISUPPORT_CHANTYPES_MAX+1];  // CHANLIMIT, e.g. "#&:20" is types "#&",
+	uint8_t chanlimit[IRC_ISUPPORT_CHANTYPES_MAX];        // limit 20 for each,
+	uint8_t chanlimit_group[IRC_ISUPPORT_CHANTYPES_MAX];  // and group 0 as they share that limit
+	char prefix_modes[IRC_ISUPPORT_PREFIX_MAX+1];  // PREFIX=(ov)@+ is modes "ov"
+	char prefix_chars[IRC_ISUPPORT_PREFIX_MAX+1];  // and prefixes "@+"
+	char chanmodes_param[IRC_ISUPPORT_CHANMODES_MAX+1];  // CHANMODES types A & B: always take a parameter
+	char chanmodes_setparam[IRC_ISUPPORT_CHANMODES_MAX+1];  // Type C: take one only when set
+} IrcISupport;
+
+#if IRC_MEMBERS_MAX > 0
+#define IRC_MEMBER_NONE 0xFFFF
+#define IRC_MEMBER_STALE 0x01  // Not (yet) seen in the NAMES list being received; removed at its end
+
+// A nick stored once for all the channels we see it in
+typedef struct {
+	char nick[IRC_NICKUSER_MAXLEN];
+	uint16_t hash;   // caseHash() of nick
+	uint16_t first;  // First of its IrcMember entries; next free entry while this one is unused
+	uint16_t count;  // Channels it's in; the entry is released when this reaches 0
+} IrcNickEntry;
+
+// One nick's presence in one channel, linked into both the channel's and the nick's list
+typedef struct {
+	uint16_t nick;  // IrcNickEntry index
+	uint16_t chan;  // Channel index
+	uint16_t chan_prev, chan_next;
+	uint16_t nick_prev, nick_next;  // nick_next is the next free entry while unused
+	uint8_t modes;  // Bit n set = has the channel mode isupport.prefix_modes[n] (e.g. o for @)
+	uint8_t flags;
+} IrcMember;
+#endif
+
+// getIngressStats() report; counts since the bot was created
+typedef struct {
+	uint32_t bytesRead;
+	uint32_t lines;               // Lines handed on for parsing
+	uint32_t fullReads;           // Reads cut short because the ring buffer filled up (more data left waiting)
+	uint32_t oversizedLines;      // Lines over IRC_INGRESS_LINE_MAX, discarded
+	uint32_t bytesDiscarded;      // Their bytes
+	unsigned int peakLen;         // Most bytes the ring buffer has held
+} IrcIngressStats;
+
+// getMemberStats() report
+typedef struct {
+	unsigned int nicks;           // Distinct nicks stored
+	unsigned int members;         // Channel memberships
+	uint32_t overflows;           // Memberships not tracked because a table was full
+	unsigned int bytesUsed;       // Table memory holding them, with their share of the hash indexes
+	unsigned int bytesPerMember;  // bytesUsed / members
+	unsigned int bytesReserved;   // Total size of the tables (fixed at compile time)
+} IrcMemberStats;
+
+// A line waiting in the flood control queue; its bytes live in IrcBotBase::txq_buf
+typedef struct {
+	uint16_t offset;
+	uint16_t len;     // 0 once sent; the slot is reclaimed when it reaches the head of the queue
+	uint16_t target;  // Hash of the message target, 0 = none
+	uint8_t round;    // Lines already waiting for the same target when this one was queued
+} IrcQueuedLine;
+
+typedef void(*IRC_CALLBACK_TYPE_MESSAGE)(void *userobj, const IrcMessage *msg);
+
 typedef struct {
 	int argc;
 	char *buffer;
@@ -77,58 +315,280 @@ typedef struct {
 } CmdTok;
 
 
+#ifdef IRC_NETWORK_DNSCLIENT
+int ircDnsResolve(const char *host, IPAddress &ip);
+#endif
+
+// Bulk delimiter search used by the ingress path; returns len if neither a nor b is found.
+unsigned int ircScanDelim(const uint8_t *buf, unsigned int len, const uint8_t a, const uint8_t b);
+
+
 enum {
 	IRC_DISCONNECTED = 0,
 	IRC_CONNECTING,
-	IRC_CONNECTED,
-	IRC_SERVERINIT,
-	IRC_REGISTERING_NICK,
-	IRC_NICK_REGISTERED,
-	IRC_REGISTERING_USER,
-	IRC_USER_REGISTERED,
-	IRC_MOTD_FINISHED
+	IRC_REGISTERING,  // PASS/NICK/USER sent; waiting for the server's welcome (001)
+	IRC_REGISTERED,   // Welcomed; waiting for the end of the MOTD
+	IRC_MOTD_FINISHED,
+
+	// Deprecated: the older step-by-step registration states, for sketches that still test getState() against them
+	IRC_CONNECTED = IRC_REGISTERING,
+	IRC_SERVERINIT = IRC_REGISTERING,
+	IRC_REGISTERING_NICK = IRC_REGISTERING,
+	IRC_NICK_REGISTERED = IRC_REGISTERING,
+	IRC_REGISTERING_USER = IRC_REGISTERING,
+	IRC_USER_REGISTERED = IRC_REGISTERED
 };
 
+// Hash index size for a table of n entries: a power of two, at most half full
+constexpr unsigned int ircHashSlots(const unsigned int n, const unsigned int slots = 4)
+{
+	return (slots >= 2*n) ? slots : ircHashSlots(n, slots*2);
+}
+
+// Message handlers, indexed by IrcReplyCode.handler
+enum {
+	IRC_HANDLER_NONE = 0,
+	IRC_HANDLER_PING,
+	IRC_HANDLER_PONG,
+	IRC_HANDLER_ENDOFMOTD,
+	IRC_HANDLER_JOINPART,
+	IRC_HANDLER_PRIVMSG,
+	IRC_HANDLER_NICKERROR,
+	IRC_HANDLER_WELCOME,
+	IRC_HANDLER_BANNED,
+	IRC_HANDLER_CAP,
+	IRC_HANDLER_SASL,
+	IRC_HANDLER_ISUPPORT,
+	IRC_HANDLER_MEMBERSHIP,
+	IRC_HANDLER_MAX
+};
+
+#define IRC_REPLY_HANDLED 0x01  // Acted on by the bot's own state machine
+#define IRC_REPLY_FORWARD 0x02  // Passed on to the OnReply callback
+
+/* Textual version of all the numbered replies and commands, along with how each is routed */
+typedef struct {
+	unsigned int code;
+	const char *description;
+	uint8_t handler;  // IRC_HANDLER_* which acts on this code
+	uint8_t flags;    // IRC_REPLY_* flags
+} IrcReplyCode;
+
 enum {
 	IRC_CHAN_NOTJOINED = 0,
 	IRC_CHAN_JOINING,
 	IRC_CHAN_JOINED,
-	IRC_CHAN_NEEDAUTH
+	IRC_CHAN_NEEDAUTH,
+	IRC_CHAN_UNAVAILABLE  // Not valid on this server, or over its CHANLIMIT; retried after reconnecting
 };
 
 
 
-class IrcBot {
+/* Where an instance's tables live and how many entries each has; BasicIrcBot<Config> owns the
+ * storage and hands this to IrcBotBase when it is constructed.
+ */
+typedef struct {
+	unsigned int channels, userCallbacks, commands;
+	unsigned int ingressLen, egressLen, queueLines, queueLen;
+	unsigned int members, nicks;
+	char (*channelNames)[IRC_CHANNEL_MAXLEN];
+	char (*channelKeys)[IRC_CHANKEY_MAXLEN];
+	int *chanState;
+	uint16_t *chanHash, *chanHashIndex;
+	ChanCallbackRegistry *joinCallbacks, *partCallbacks;
+	ChanUserCallbackRegistry *userJoinCallbacks, *userPartCallbacks;
+	CmdRegistry *commandRegistry;
+	uint16_t *commandHashIndex;
+	uint8_t *ringbuf, *txbuf, *txqBuf;
+	IrcQueuedLine *txq;
+#if IRC_MEMBERS_MAX > 0
+	IrcNickEntry *nickTable;
+	uint16_t *nickHashIndex;
+	IrcMember *memberTable;
+	uint16_t *memberHashIndex;
+	uint16_t *chanMembers, *chanMemberCount;
+	boolean *chanNamesActive;
+#endif
+} IrcBotStorage;
+
+/* The bot itself.  Sketches declare an IrcBot (or a BasicIrcBot<Config>); code which only drives a bot,
+ * such as IrcBotPool, takes an IrcBotBase so it works with any configuration.
+ */
+class IrcBotBase {
 	private:
 		IRC_NETWORK_CLIENT_CLASS conn;
 		Stream *Dbg;
+		uint8_t _loglevel;
 		int botState;
 		char _ircnick[IRC_NICKUSER_MAXLEN], _ircuser[IRC_NICKUSER_MAXLEN], _ircdescription[IRC_DESCRIPTION_MAXLEN];
+		char _ircwantnick[IRC_NICKUSER_MAXLEN];  // Nick from setNick(); _ircnick is the one actually in use
 		char _ircserver[IRC_SERVERNAME_MAXLEN];
-		char _ircchannels[IRC_CHANNEL_MAX][IRC_CHANNEL_MAXLEN];
-		int chanState[IRC_CHANNEL_MAX];
+		int chan_max;
+		char (*_ircchannels)[IRC_CHANNEL_MAXLEN];
+		char (*_ircchankeys)[IRC_CHANKEY_MAXLEN];  // +k key to join with, "" for none
+		int *chanState;
+		unsigned int chanHashSlots;
+		uint16_t *chanHash;         // caseHash() of each defined channel's name
+		uint16_t *chanHashIndex;    // Channel index + 1, 0 = empty slot
+		uint8_t casefold_last;  // Highest character CASEMAPPING folds: 'Z' (ascii), ']' (strict-rfc1459) or '^'
+		uint8_t caseFold(const uint8_t c) { return (c >= 'A' && c <= casefold_last) ? c + ('a' - 'A') : c; };
+		uint16_t caseHash(const char *name);
+		boolean caseEqual(const char *a, const char *b);
+		void setCaseMapping(const uint8_t casemapping);
+		int channelLookup(const char *chan, unsigned int *slotp = NULL);
+		void channelIndexAdd(const int chanidx);
+		void channelIndexRemove(const int chanidx);
+		static unsigned int channelHome(const void *bot, const unsigned int chanidx);  // Hash index home slots, for ircHashIndexRemove()
+		void channelIndexRebuild(void);
+#if IRC_MEMBERS_MAX > 0
+		unsigned int nicks_max, members_max;  // 0 = this instance doesn't track membership
+		unsigned int nickHashSlots, memberHashSlots;
+		IrcNickEntry *nickTable;
+		uint16_t *nickHashIndex;      // nickTable index + 1, 0 = empty slot
+		IrcMember *memberTable;
+		uint16_t *memberHashIndex;    // memberTable index + 1, keyed on (channel, nick)
+		uint16_t nickFree, memberFree;  // Heads of the unused entry lists
+		uint16_t *chanMembers;        // First member of each channel
+		uint16_t *chanMemberCount;
+		boolean *chanNamesActive;     // Between a channel's first 353 and its 366
+		unsigned int nickCount, memberCount;
+		uint32_t member_overflows;
+		static uint16_t memberHash(const unsigned int chanidx, const unsigned int nickid);
+		int nickLookup(const char *nick, unsigned int *slotp = NULL);
+		int nickIntern(const char *nick);
+		void nickIndexAdd(const unsigned int nickid);
+		void nickIndexRemove(const unsigned int nickid);
+		static unsigned int nickHome(const void *bot, const unsigned int nickid);
+		int memberLookup(const int chanidx, const int nickid, unsigned int *slotp = NULL);
+		void memberRemove(const unsigned int m);
+		static unsigned int memberHome(const void *bot, const unsigned int m);
+#endif
+		// Membership updates; no-ops when membership isn't tracked
+		void memberReset(void);
+		int memberAdd(const int chanidx, const char *nick, const uint8_t modes);
+		void memberPart(const int chanidx, const char *nick);
+		void memberClearChannel(const int chanidx);
+		void memberQuit(const char *nick);
+		void memberNamesBegin(const int chanidx);
+		void memberNamesEnd(const int chanidx);
+		void memberRename(const char *oldnick, const char *newnick);
+		uint8_t prefixModes(const char **nick);
 		uint16_t _ircport;
-		uint8_t tcpbuf[IRC_INGRESS_BUFFER_LEN];
-		uint8_t ringbuf[IRC_INGRESS_RINGBUF_LEN];
+		unsigned int ringbuf_size;
+		uint8_t *ringbuf;  // ringbuf_size + IRC_INGRESS_LINE_MAX + 1; slack past the end holds the head of a wrapped line
 		unsigned int ringbuf_start, ringbuf_end;
-		uint32_t nick_user_millis;
+		unsigned int ringbuf_scan;  // Bytes past ringbuf_start already searched for a line terminator
+		boolean ringbuf_skiplf;     // Last line ended in \r; drop a \n if it's the next byte to arrive
+		boolean ringbuf_discard;    // Inside an oversized line; drop everything up to its terminator
+		IrcIngressStats ingress;
+		char _ircpass[IRC_PASSWORD_MAXLEN];
+		unsigned int nick_attempts;  // Alternate nicks tried during this registration
+		unsigned int nick_baselen;   // Length of the nick we asked for; alternates replace what follows
+		void sendRegistration(void);
+		uint16_t cap_wanted;     // IRC_CAP_* bits the sketch asked for
+		uint16_t cap_available;  // Offered by the server (CAP LS / NEW)
+		uint16_t cap_enabled;    // Acknowledged by the server
+		boolean cap_negotiating; // Registration is held until we send CAP END
+		static uint16_t ircCapParse(const char *list);
+		void sendCapRequest(uint16_t caps);
+		void endCapNegotiation(void);
+		uint8_t sasl_mech;
+		uint8_t sasl_status;
+		char _saslacct[IRC_SASL_ACCOUNT_MAXLEN];
+		char _saslpass[IRC_PASSWORD_MAXLEN];
+		void sendSaslResponse(void);
+		IrcISupport isupport;
+		void isupportReset(void);
+		boolean channelAllowed(const int chanidx);
+		unsigned int targetMax(const int cmdtoken);
+		void sendJoins(void);
+		uint32_t throttle_millis;  // Time of the last connect attempt or disconnect
+		uint32_t reconnect_delay;  // ms to wait after throttle_millis before the next attempt
+		unsigned int reconnect_attempts;
+		uint32_t registered_millis;  // When we last finished registering, 0 = not since the last attempt
+		uint32_t rng_state;
+		IrcReconnectPolicy reconnectPolicy;
+		void scheduleReconnect(void);
+		uint32_t ircRandom(void);
+		uint32_t connect_millis;   // Time the current connect attempt started
+		IPAddress _ircserverip;    // Cached address of _ircserver
+		uint32_t dns_millis;       // Time _ircserverip was resolved
+		boolean dns_valid;
+		boolean resolveServer(void);
 		boolean _enabled;
 		boolean _hasmotd;
 		
 		void InitVariables(void);
+		void useTables(const IrcBotStorage &tables);
 		void processInboundData(void);  // RX state machine for TCP connection
-		int ircProtocolCommandToken(const char *cmd);
+		boolean parseMessage(char *line, IrcMessage *msg);
+		static void parseTags(char *tags, unsigned int len, IrcMessage *msg);
+		boolean processMessage(IrcMessage *msg);
+		typedef boolean (IrcBotBase::*MessageHandler)(IrcMessage *msg);
+		static const MessageHandler messageHandlers[IRC_HANDLER_MAX];
+		boolean handlePing(IrcMessage *msg);
+		boolean handlePong(IrcMessage *msg);
+		boolean handleEndOfMotd(IrcMessage *msg);
+		boolean handleJoinPart(IrcMessage *msg);
+		boolean handlePrivmsg(IrcMessage *msg);
+		boolean handleNickError(IrcMessage *msg);
+		boolean handleWelcome(IrcMessage *msg);
+		boolean handleBanned(IrcMessage *msg);
+		boolean handleCap(IrcMessage *msg);
+		boolean handleSasl(IrcMessage *msg);
+		boolean handleISupport(IrcMessage *msg);
+		boolean handleMembership(IrcMessage *msg);
+		static const IrcReplyCode *ircReplyCodeLookup(const int cmdtoken);
 		const char *ircReplyCodeStrerror(unsigned int cmdtoken);
 		inline unsigned int ringBufferLen(void);
-		int ringBufferSearch(const uint8_t search);
-		unsigned int ringBufferSearchConsume(void *buf, const uint8_t search);
-		unsigned int ringBufferSearchFlush(const uint8_t search);
-		unsigned int ringBufferConsume(void *buf, const unsigned int maxlen);
+		inline unsigned int ringBufferFree(void);
+		int ringBufferFill(void);
+		void ringBufferReset(void);
+		int ringBufferFrameLine(void);
+		char *ringBufferLine(const unsigned int linelen);
 		unsigned int ringBufferFlush(const unsigned int count);
-		void writebuf(const uint8_t *buf);
-		void writebuf(const char *buf) { writebuf((const uint8_t *)buf); };
-		void writebuf(const char c) { conn.write((uint8_t)c); };
-		void writebuf(const uint8_t c) { conn.write(c); };
+		/* Egress line builder - each outbound line is assembled in txbuf then written with a single
+		 * conn.write().  While loop() runs, finished lines are held so everything it sends goes out together.
+		 * Whatever the socket doesn't take stays at the front of txbuf until a later flush.
+		 */
+		unsigned int txbuf_size;
+		uint8_t *txbuf;
+		unsigned int txbuf_len;   // Bytes of complete lines waiting to be written
+		unsigned int txbuf_line;  // Bytes of the line being assembled, stored right after txbuf_len
+		boolean txbuf_hold;       // Set inside loop(); flushed when it returns
+		boolean txbuf_drop;       // No room for the line being assembled; lineEnd() discards it
+		boolean egressLineRoom(void);
+		boolean egressLineDropped(void);
+		void lineAppend(const char *str);
+		void lineAppend(const char c);
+		void lineAppend(const char *str, unsigned int len);
+		boolean lineEnd(const char *target = NULL);  // Normal lane; paced by flood control
+		void lineEndPriority(void);                  // PONG, registration & QUIT; bypasses the queue
+		unsigned int self_prefixlen;  // Length of "nick!user@host" as the server relays us, 0 = not seen yet
+		boolean sendSplit(const char *verb, const char *target, const char *lead, const char *leadsep, const char *message, boolean ctcp);
+		void egressFlush(void);
+		/* Flood control - a token bucket on lines and on bytes.  Normal lane lines that can't go out yet
+		 * wait in txq (records) / txq_buf (bytes) and are drained by loop().
+		 */
+		unsigned int txq_lines, txq_size;
+		IrcQueuedLine *txq;
+		uint8_t *txq_buf;
+		unsigned int txq_head, txq_count;  // Records in use, including sent ones not yet reclaimed
+		unsigned int txq_pending;          // Records still waiting to be sent
+		unsigned int txq_tail;             // Next free byte in txq_buf
+		uint32_t txq_drops;
+		uint32_t flood_linetokens;  // Milliseconds of line credit
+		uint32_t flood_bytetokens;  // Bytes of credit, x1000
+		uint32_t flood_millis;
+		unsigned int flood_burst, flood_msperline, flood_bytespersec;
+		boolean flood_fair;
+		void floodRefill(void);
+		boolean floodAllow(unsigned int len);
+		void floodCharge(unsigned int len);
+		boolean egressEnqueue(const uint8_t *line, unsigned int len, const char *target);
+		void egressDrain(boolean all = false);
+		void egressReset(void);
+		void processLoop(void);
 
 		/* Callback handling */
 		// Connect & disconnect (only 1 allowed)
@@ -138,6 +598,9 @@ class IrcBot {
 
 		IRC_CALLBACK_TYPE_CONNECT disconnectCallback;
 		void *disconnectCallbackUserobj;
+
+		IRC_CALLBACK_TYPE_RECONNECT reconnectCallback;
+		void *reconnectCallbackUserobj;
 		void executeOnDisconnectCallback(void);
 
 		IRC_CALLBACK_TYPE_CONNECT motdFinishedCallback;
@@ -145,47 +608,97 @@ class IrcBot {
 		void executeOnMotdFinishedCallback(void);
 
 		// Channel join & part (only 1 allowed per channel)
-		ChanCallbackRegistry channelJoinCallbacks[IRC_CHANNEL_MAX];
+		ChanCallbackRegistry *channelJoinCallbacks;
 		void executeOnChannelJoinCallback(const int);
-		ChanCallbackRegistry channelPartCallbacks[IRC_CHANNEL_MAX];
+		ChanCallbackRegistry *channelPartCallbacks;
 		void executeOnChannelPartCallback(const int);
 
-		// Trap on other users joining & parting certain channels (IRC_CALLBACK_MAX_CHANNELNICK allowed)
-		ChanUserCallbackRegistry channelUserJoinCallbacks[IRC_CALLBACK_MAX_CHANNELNICK];
-		ChanUserCallbackRegistry channelUserPartCallbacks[IRC_CALLBACK_MAX_CHANNELNICK];
-
-		// Registry of commands directed at this bot
-		CmdRegistry commandCallbackRegistry[IRC_COMMAND_REGISTRY_MAX];
+		// Trap on other users joining & parting certain channels (usercb_max of each allowed)
+		int usercb_max;
+		ChanUserCallbackRegistry *channelUserJoinCallbacks;
+		ChanUserCallbackRegistry *channelUserPartCallbacks;
+
+		// Registry of commands directed at this bot; kept dense, looked up through an open-addressed hash index
+		int cmd_max;
+		unsigned int commandHashSlots;
+		CmdRegistry *commandCallbackRegistry;
+		uint16_t *commandHashIndex;  // Registry index + 1, 0 = empty slot
+		unsigned int commandCount;
+		static uint16_t ircCommandHash(const char *cmd);
+		int commandLookup(const char *cmd, unsigned int *slotp = NULL);
+		static unsigned int commandHome(const void *bot, const unsigned int i);
 		IRC_CALLBACK_TYPE_COMMAND unknownCommandCallback;
 		void *unknownCommandCallbackUserobj;
 
+		// Server replies & commands flagged IRC_REPLY_FORWARD (only 1 allowed)
+		IRC_CALLBACK_TYPE_MESSAGE replyCallback;
+		void *replyCallbackUserobj;
+
+		// NAMES entries, one nick at a time
+		IRC_CALLBACK_TYPE_NAMES namesCallback;
+		void *namesCallbackUserobj;
+
+
+	protected:
+		IrcBotBase(const IrcBotStorage &tables);
+		IrcBotBase(const IrcBotStorage &tables, Stream *debugStream, const char *server, const char *nick, const char *user, const char *desc);
 
 	public:
 		static const uint32_t version;
 		static const char *versionString;
 
-		IrcBot();
-		IrcBot(Stream *debugStream, const char *server, const char *nick, const char *user, const char *desc);
-
 		void setServer(const char *server);
 		void setPort(uint16_t ircPort);
 		void setNick(const char *nick);
 		void setUsername(const char *user);
 		void setDescription(const char *desc);
-		int addChannel(const char *chan);
+		void setPassword(const char *pass);  // Server password (PASS); NULL or "" for none
+		void setCapabilities(uint16_t caps);  // IRC_CAP_* bits to request when registering
+		uint16_t getCapabilities(void);       // IRC_CAP_* bits the server has enabled
+		// Log in with SASL before registration completes; account/password are only used by IRC_SASL_PLAIN
+		void setSasl(uint8_t mech, const char *account = NULL, const char *password = NULL);
+		uint8_t getSaslStatus(void);  // IRC_SASL_* status for the current connection
+		const IrcISupport *getISupport(void) { return &isupport; };
+
+		/* Channel membership, kept from NAMES, JOIN, PART, QUIT, NICK, KICK and MODE (needs IRC_MEMBERS_MAX,
+		 * and Members in the instance's config).
+		 * Modes are bitmasks over isupport.prefix_modes (bit 0 is the highest rank, usually o).
+		 */
+		boolean isOnChannel(const char *chan, const char *nick);
+		int getMemberModes(const char *chan, const char *nick);  // -1 if nick isn't there
+		char getMemberPrefix(const char *chan, const char *nick);  // Highest prefix such as '@'; '\0' for none
+		unsigned int getMemberCount(const char *chan);
+		// Fills nicks[] with up to max members ranked minprefix or higher (e.g. '@' for ops; '\0' for all)
+		unsigned int getMembers(const char *chan, const char **nicks, unsigned int max, char minprefix = '\0');
+		void getMemberStats(IrcMemberStats *stats);
+		void getIngressStats(IrcIngressStats *stats) { *stats = ingress; };
+		int addChannel(const char *chan, const char *key = NULL);
 		int removeChannel(const int chanidx);
 		int removeChannel(const char *chan);
 		void begin(void);
 		void end(void);
 		void loop(void);  // Run a loop of the IRC Bot's state machine
+		void setReconnectPolicy(const IrcReconnectPolicy *policy);
+		unsigned long pollTimeout(void);  // ms until loop() has timed work to do; IRC_POLL_IDLE if it only waits on the socket
+		int getSocket(void);  // Descriptor to wait on for readability, -1 if the transport has none
+		boolean hasInput(void);  // Data (or a disconnect) is waiting for loop() to process
+		boolean pollWritable(void);  // Socket should also be watched for writability (connect in progress, or unsent egress)
 		boolean sendPrivmsg(const char *chan, const char *tonick, const char *message);
 		boolean sendPrivmsgCtcp(const char *chan, const char *ctcpcmd, const char *message);
 		boolean sendPrivmsgUser(const char *user, const char *message);
+		// One message to several channels/nicks, sent as "PRIVMSG a,b,c" in batches the server's TARGMAX allows
+		boolean sendPrivmsgMulti(const char *targets[], unsigned int count, const char *message);
 		int getState(void);  // Get the master state of the bot in enum value
 		const char *getStateStrerror(void);
 		boolean parseUserHostString(const void *str, char *nick, char *user, char *host);
-		void setDebug(Stream *debugStream);
+		void setDebug(Stream *debugStream);  // NULL disables debug output
+		void setLogLevel(uint8_t level);
+		void setFloodControl(unsigned int burstLines, unsigned int msPerLine, unsigned int bytesPerSec);  // 0 disables a limit
+		void setFloodFairness(boolean enable);  // Round-robin queued lines between message targets
+		unsigned int getQueueDepth(void);  // Lines waiting on flood control
+		uint32_t getQueueDrops(void);      // Lines dropped because the queue was full
 		void argToken(char *buffer, CmdTok *ts);
+		static int ircProtocolCommandToken(const char *cmd);
 
 		boolean isConnected();
 
@@ -200,6 +713,9 @@ class IrcBot {
 		boolean attachOnCommand( const char *cmd, const char **authnicks, IRC_CALLBACK_TYPE_COMMAND, const void *userobj );
 		boolean attachOnUnknownCommand( IRC_CALLBACK_TYPE_COMMAND, const void *userobj );
 		boolean attachOnCommandUnauthorized( const char *cmd, IRC_CALLBACK_TYPE_COMMAND );
+		boolean attachOnReply( IRC_CALLBACK_TYPE_MESSAGE, const void *userobj );
+		boolean attachOnReconnect( IRC_CALLBACK_TYPE_RECONNECT, const void *userobj );  // Each time a reconnect is scheduled
+		boolean attachOnNames( IRC_CALLBACK_TYPE_NAMES, const void *userobj );  // Every NAMES reply, ours or requested
 
 		boolean detachOnConnect(void);
 		boolean detachOnDisconnect(void);
@@ -213,30 +729,196 @@ class IrcBot {
 		boolean detachOnCommand( const char *cmd );
 		boolean detachOnUnknownCommand(void);
 		boolean detachOnCommandUnauthorized( const char *cmd );
+		boolean detachOnReply(void);
+		boolean detachOnReconnect(void);
+		boolean detachOnNames(void);
 };
 
+/* Per-instance table sizes for BasicIrcBot<Config>.  Derive from IrcBotConfig and override only what
+ * should differ, e.g.
+ *   struct TinyBotConfig : IrcBotConfig {
+ *     static const unsigned int Channels = 1, UserCallbacks = 0, Commands = 4;
+ *     static const unsigned int IngressBuffer = 600, EgressQueueLines = 4, EgressQueueBytes = 512;
+ *   };
+ *   BasicIrcBot<TinyBotConfig> irc;
+ * UserCallbacks, Commands and Members can be 0 to do without that feature (and its memory) entirely.
+ */
+struct IrcBotConfig {
+	static const unsigned int Channels = IRC_CHANNEL_MAX;
+	static const unsigned int UserCallbacks = IRC_CALLBACK_MAX_CHANNELNICK;  // attachOnUserJoin/Part() slots of each kind
+	static const unsigned int Commands = IRC_COMMAND_REGISTRY_MAX;
+	static const unsigned int IngressBuffer = IRC_INGRESS_RINGBUF_LEN;
+	static const unsigned int EgressBuffer = IRC_EGRESS_BUFFER_LEN;
+	static const unsigned int EgressQueueLines = IRC_EGRESS_QUEUE_LINES;
+	static const unsigned int EgressQueueBytes = IRC_EGRESS_QUEUE_LEN;
+	static const unsigned int Members = IRC_MEMBERS_DEFAULT;
+	static const unsigned int Nicks = IRC_MEMBERS_DEFAULT / 2;  // Usually Members / 2
+};
+
+// A table of N entries; none at all (and no pointer to one) when N is 0
+template<typename T, unsigned int N> struct IrcTable {
+	T entry[N];
+	T *get(void) { return entry; };
+};
+
+template<typename T> struct IrcTable<T, 0> {
+	T *get(void) { return NULL; };
+};
+
+template<class Config> struct IrcBotTables {
+	static const unsigned int members = Config::Members;
+	static const unsigned int nicks = members ? Config::Nicks : 0;
+
+	static_assert(Config::Channels > 0 && Config::Channels < 0xFFFF, "Channels must be 1 to 65534");
+	static_assert(Config::Commands < 0xFFFF, "Commands must be under 65535");
+	static_assert(Config::IngressBuffer > IRC_INGRESS_LINE_MAX, "IngressBuffer must be larger than IRC_INGRESS_LINE_MAX");
+	static_assert(Config::EgressBuffer >= IRC_EGRESS_LINE_MAX, "EgressBuffer must hold at least one full line");
+	static_assert(Config::EgressQueueLines > 0, "EgressQueueLines must be at least 1");
+	static_assert(IRC_MEMBERS_MAX > 0 || members == 0, "Membership tracking is compiled out; define IRC_MEMBERS_MAX to use it");
+	static_assert(members == 0 || (nicks > 0 && nicks < 0xFFFF && members < 0xFFFF), "Members and Nicks must be 1 to 65534");
+
+	char channelNames[Config::Channels][IRC_CHANNEL_MAXLEN];
+	char channelKeys[Config::Channels][IRC_CHANKEY_MAXLEN];
+	int chanState[Config::Channels];
+	uint16_t chanHash[Config::Channels];
+	uint16_t chanHashIndex[ircHashSlots(Config::Channels)];
+	ChanCallbackRegistry joinCallbacks[Config::Channels];
+	ChanCallbackRegistry partCallbacks[Config::Channels];
+	IrcTable<ChanUserCallbackRegistry, Config::UserCallbacks> userJoinCallbacks, userPartCallbacks;
+	IrcTable<CmdRegistry, Config::Commands> commandRegistry;
+	uint16_t commandHashIndex[ircHashSlots(Config::Commands)];
+	uint8_t ringbuf[Config::IngressBuffer + IRC_INGRESS_LINE_MAX + 1];
+	uint8_t txbuf[Config::EgressBuffer];
+	IrcQueuedLine txq[Config::EgressQueueLines];
+	uint8_t txqBuf[Config::EgressQueueBytes];
+#if IRC_MEMBERS_MAX > 0
+	IrcTable<IrcNickEntry, nicks> nickTable;
+	IrcTable<uint16_t, nicks ? ircHashSlots(nicks) : 0> nickHashIndex;
+	IrcTable<IrcMember, members> memberTable;
+	IrcTable<uint16_t, members ? ircHashSlots(members) : 0> memberHashIndex;
+	IrcTable<uint16_t, members ? Config::Channels : 0> chanMembers, chanMemberCount;
+	IrcTable<boolean, members ? Config::Channels : 0> chanNamesActive;
+#endif
+
+	IrcBotStorage layout(void)
+	{
+		IrcBotStorage t;
+
+		t.channels = Config::Channels;
+		t.userCallbacks = Config::UserCallbacks;
+		t.commands = Config::Commands;
+		t.ingressLen = Config::IngressBuffer;
+		t.egressLen = Config::EgressBuffer;
+		t.queueLines = Config::EgressQueueLines;
+		t.queueLen = Config::EgressQueueBytes;
+		t.members = members;
+		t.nicks = nicks;
+		t.channelNames = channelNames;
+		t.channelKeys = channelKeys;
+		t.chanState = chanState;
+		t.chanHash = chanHash;
+		t.chanHashIndex = chanHashIndex;
+		t.joinCallbacks = joinCallbacks;
+		t.partCallbacks = partCallbacks;
+		t.userJoinCallbacks = userJoinCallbacks.get();
+		t.userPartCallbacks = userPartCallbacks.get();
+		t.commandRegistry = commandRegistry.get();
+		t.commandHashIndex = commandHashIndex;
+		t.ringbuf = ringbuf;
+		t.txbuf = txbuf;
+		t.txq = txq;
+		t.txqBuf = txqBuf;
+#if IRC_MEMBERS_MAX > 0
+		t.nickTable = nickTable.get();
+		t.nickHashIndex = nickHashIndex.get();
+		t.memberTable = memberTable.get();
+		t.memberHashIndex = memberHashIndex.get();
+		t.chanMembers = chanMembers.get();
+		t.chanMemberCount = chanMemberCount.get();
+		t.chanNamesActive = chanNamesActive.get();
+#endif
+		return t;
+	};
+};
+
+/* An IrcBot whose tables are sized by Config, so each instance takes only the memory it needs.  The
+ * tables come first in the object so they exist before IrcBotBase's constructor initializes them;
+ * that also means a bot passed as a callback's void *userobj must be cast back to its own type.
+ */
+template<class Config = IrcBotConfig>
+class BasicIrcBot : private IrcBotTables<Config>, public IrcBotBase {
+	public:
+		BasicIrcBot() : IrcBotBase(this->layout()) { };
+		BasicIrcBot(Stream *debugStream, const char *server, const char *nick, const char *user, const char *desc)
+			: IrcBotBase(this->layout(), debugStream, server, nick, user, desc) { };
+};
+
+typedef BasicIrcBot<> IrcBot;
+
 // IRC protocol commands & tokens
-#define IRC_CMDTOKEN_PRIVMSG   901    // Reply codes 900+ don't exist, this is just being used to
-#define IRC_CMDTOKEN_NOTICE    902    // allow contiguous use of both numeric reply codes and text commands.
-#define IRC_CMDTOKEN_PASS      903
-#define IRC_CMDTOKEN_NICK      904
-#define IRC_CMDTOKEN_USER      905
-#define IRC_CMDTOKEN_OPER      906
-#define IRC_CMDTOKEN_MODE      907
-#define IRC_CMDTOKEN_SERVICE   908
-#define IRC_CMDTOKEN_QUIT      909
-#define IRC_CMDTOKEN_JOIN      910
-#define IRC_CMDTOKEN_PART      911
-#define IRC_CMDTOKEN_TOPIC     912
-#define IRC_CMDTOKEN_INVITE    913
-#define IRC_CMDTOKEN_KICK      914
-#define IRC_CMDTOKEN_PING      915
-#define IRC_CMDTOKEN_PONG      916
+#define IRC_CMDTOKEN_VERB_BASE 1000  // Text commands are numbered above the 3-digit reply code space (900-999 are in use, e.g. SASL)
+#define IRC_CMDTOKEN_PRIVMSG   (IRC_CMDTOKEN_VERB_BASE+1)
+#define IRC_CMDTOKEN_NOTICE    (IRC_CMDTOKEN_VERB_BASE+2)
+#define IRC_CMDTOKEN_PASS      (IRC_CMDTOKEN_VERB_BASE+3)
+#define IRC_CMDTOKEN_NICK      (IRC_CMDTOKEN_VERB_BASE+4)
+#define IRC_CMDTOKEN_USER      (IRC_CMDTOKEN_VERB_BASE+5)
+#define IRC_CMDTOKEN_OPER      (IRC_CMDTOKEN_VERB_BASE+6)
+#define IRC_CMDTOKEN_MODE      (IRC_CMDTOKEN_VERB_BASE+7)
+#define IRC_CMDTOKEN_SERVICE   (IRC_CMDTOKEN_VERB_BASE+8)
+#define IRC_CMDTOKEN_QUIT      (IRC_CMDTOKEN_VERB_BASE+9)
+#define IRC_CMDTOKEN_JOIN      (IRC_CMDTOKEN_VERB_BASE+10)
+#define IRC_CMDTOKEN_PART      (IRC_CMDTOKEN_VERB_BASE+11)
+#define IRC_CMDTOKEN_TOPIC     (IRC_CMDTOKEN_VERB_BASE+12)
+#define IRC_CMDTOKEN_INVITE    (IRC_CMDTOKEN_VERB_BASE+13)
+#define IRC_CMDTOKEN_KICK      (IRC_CMDTOKEN_VERB_BASE+14)
+#define IRC_CMDTOKEN_PING      (IRC_CMDTOKEN_VERB_BASE+15)
+#define IRC_CMDTOKEN_PONG      (IRC_CMDTOKEN_VERB_BASE+16)
+#define IRC_CMDTOKEN_SQUIT     (IRC_CMDTOKEN_VERB_BASE+17)
+#define IRC_CMDTOKEN_NAMES     (IRC_CMDTOKEN_VERB_BASE+18)
+#define IRC_CMDTOKEN_LIST      (IRC_CMDTOKEN_VERB_BASE+19)
+#define IRC_CMDTOKEN_MOTD      (IRC_CMDTOKEN_VERB_BASE+20)
+#define IRC_CMDTOKEN_LUSERS    (IRC_CMDTOKEN_VERB_BASE+21)
+#define IRC_CMDTOKEN_VERSION   (IRC_CMDTOKEN_VERB_BASE+22)
+#define IRC_CMDTOKEN_STATS     (IRC_CMDTOKEN_VERB_BASE+23)
+#define IRC_CMDTOKEN_LINKS     (IRC_CMDTOKEN_VERB_BASE+24)
+#define IRC_CMDTOKEN_TIME      (IRC_CMDTOKEN_VERB_BASE+25)
+#define IRC_CMDTOKEN_CONNECT   (IRC_CMDTOKEN_VERB_BASE+26)
+#define IRC_CMDTOKEN_TRACE     (IRC_CMDTOKEN_VERB_BASE+27)
+#define IRC_CMDTOKEN_ADMIN     (IRC_CMDTOKEN_VERB_BASE+28)
+#define IRC_CMDTOKEN_INFO      (IRC_CMDTOKEN_VERB_BASE+29)
+#define IRC_CMDTOKEN_SERVLIST  (IRC_CMDTOKEN_VERB_BASE+30)
+#define IRC_CMDTOKEN_SQUERY    (IRC_CMDTOKEN_VERB_BASE+31)
+#define IRC_CMDTOKEN_WHO       (IRC_CMDTOKEN_VERB_BASE+32)
+#define IRC_CMDTOKEN_WHOIS     (IRC_CMDTOKEN_VERB_BASE+33)
+#define IRC_CMDTOKEN_WHOWAS    (IRC_CMDTOKEN_VERB_BASE+34)
+#define IRC_CMDTOKEN_KILL      (IRC_CMDTOKEN_VERB_BASE+35)
+#define IRC_CMDTOKEN_ERROR     (IRC_CMDTOKEN_VERB_BASE+36)
+#define IRC_CMDTOKEN_AWAY      (IRC_CMDTOKEN_VERB_BASE+37)
+#define IRC_CMDTOKEN_REHASH    (IRC_CMDTOKEN_VERB_BASE+38)
+#define IRC_CMDTOKEN_DIE       (IRC_CMDTOKEN_VERB_BASE+39)
+#define IRC_CMDTOKEN_RESTART   (IRC_CMDTOKEN_VERB_BASE+40)
+#define IRC_CMDTOKEN_SUMMON    (IRC_CMDTOKEN_VERB_BASE+41)
+#define IRC_CMDTOKEN_USERS     (IRC_CMDTOKEN_VERB_BASE+42)
+#define IRC_CMDTOKEN_WALLOPS   (IRC_CMDTOKEN_VERB_BASE+43)
+#define IRC_CMDTOKEN_USERHOST  (IRC_CMDTOKEN_VERB_BASE+44)
+#define IRC_CMDTOKEN_ISON      (IRC_CMDTOKEN_VERB_BASE+45)
+#define IRC_CMDTOKEN_CAP       (IRC_CMDTOKEN_VERB_BASE+46)
+#define IRC_CMDTOKEN_AUTHENTICATE (IRC_CMDTOKEN_VERB_BASE+47)
+#define IRC_CMDTOKEN_ACCOUNT   (IRC_CMDTOKEN_VERB_BASE+48)
+#define IRC_CMDTOKEN_BATCH     (IRC_CMDTOKEN_VERB_BASE+49)
+#define IRC_CMDTOKEN_CHGHOST   (IRC_CMDTOKEN_VERB_BASE+50)
+#define IRC_CMDTOKEN_SETNAME   (IRC_CMDTOKEN_VERB_BASE+51)
+#define IRC_CMDTOKEN_TAGMSG    (IRC_CMDTOKEN_VERB_BASE+52)
+#define IRC_CMDTOKEN_FAIL      (IRC_CMDTOKEN_VERB_BASE+53)
+#define IRC_CMDTOKEN_WARN      (IRC_CMDTOKEN_VERB_BASE+54)
+#define IRC_CMDTOKEN_NOTE      (IRC_CMDTOKEN_VERB_BASE+55)
+#define IRC_CMDTOKEN_VERB_LAST IRC_CMDTOKEN_NOTE
 #define IRC_CMDTOKEN_RPL_WELCOME			001
 #define IRC_CMDTOKEN_RPL_YOURHOST			002
 #define IRC_CMDTOKEN_RPL_CREATED			003
 #define IRC_CMDTOKEN_RPL_MYINFO				004
 #define IRC_CMDTOKEN_RPL_BOUNCE				005
+#define IRC_CMDTOKEN_RPL_ISUPPORT			005
 #define IRC_CMDTOKEN_RPL_USERHOST			302
 #define IRC_CMDTOKEN_RPL_ISON				303
 #define IRC_CMDTOKEN_RPL_AWAY				301
@@ -324,11 +1006,5 @@ class IrcBot {
 #define IRC_CMDTOKEN_ERR_UMODEUNKNOWNFLAG	501
 #define IRC_CMDTOKEN_ERR_USERSDONTMATCH		502
 
-/* Textual version of all the numbered replies; for debugging use */
-typedef struct {
-	unsigned int code;
-	const char *description;
-} IrcReplyCode;
-
 
 #endif
@@ -0,0 +1,117 @@
+/* IrcBotHost - Energia core stand-ins for building IrcBot on a Linux host.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#if !defined(ENERGIA) && !defined(ARDUINO)
+
+#include "IrcBotHost.h"
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+HostSerial Serial;
+
+size_t Print::write(const uint8_t *buf, size_t size)
+{
+	size_t i;
+
+	for (i=0; i < size; i++) {
+		if (!write(buf[i]))
+			break;
+	}
+	return i;
+}
+
+size_t Print::printNumber(unsigned long n, int base, boolean negative)
+{
+	char buf[8 * sizeof(long) + 2];
+	char *str = &buf[sizeof(buf) - 1];
+
+	if (base < 2)
+		base = 10;
+	*str = '\0';
+	do {
+		*--str = "0123456789ABCDEF"[n % base];
+		n /= base;
+	} while (n);
+	if (negative)
+		*--str = '-';
+	return write(str);
+}
+
+size_t Print::print(long n, int base)
+{
+	if (base == DEC && n < 0)
+		return printNumber(-(unsigned long)n, base, true);
+	return printNumber((unsigned long)n, base, false);
+}
+
+size_t Print::print(double n, int digits)
+{
+	char buf[48];
+
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+	return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buf, size_t size)
+{
+	return fwrite(buf, 1, size, stdout);
+}
+
+void HostSerial::flush(void)
+{
+	fflush(stdout);
+}
+
+static uint64_t monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Like the Energia core, these count from startup and wrap around
+unsigned long millis(void)
+{
+	static uint64_t start = monotonic_us();
+
+	return (unsigned long)(uint32_t)((monotonic_us() - start) / 1000);
+}
+
+unsigned long micros(void)
+{
+	static uint64_t start = monotonic_us();
+
+	return (unsigned long)(uint32_t)(monotonic_us() - start);
+}
+
+void delay(unsigned long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+#endif /* !ENERGIA && !ARDUINO */
@@ -0,0 +1,103 @@
+/* IrcBotHost - Minimal stand-in for the parts of the Energia core IrcBot uses (Print, Stream,
+ * Serial, millis/micros/delay) so the library can be built and run on a Linux host.
+ * Only used when building outside of Energia/Arduino; see extras/host/Makefile.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef IRCBOTHOST_H
+#define IRCBOTHOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+	private:
+		size_t printNumber(unsigned long n, int base, boolean negative);
+
+	public:
+		virtual ~Print() {};
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buf, size_t size);
+		size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); };
+
+		size_t print(const char *str) { return write(str); };
+		size_t print(char c) { return write((uint8_t)c); };
+		size_t print(int n, int base = DEC) { return print((long)n, base); };
+		size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); };
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC) { return printNumber(n, base, false); };
+		size_t print(double n, int digits = 2);
+
+		size_t println(void) { return write("\r\n"); };
+		size_t println(const char *str) { return print(str) + println(); };
+		size_t println(char c) { return print(c) + println(); };
+		size_t println(int n, int base = DEC) { return print(n, base) + println(); };
+		size_t println(unsigned int n, int base = DEC) { return print(n, base) + println(); };
+		size_t println(long n, int base = DEC) { return print(n, base) + println(); };
+		size_t println(unsigned long n, int base = DEC) { return print(n, base) + println(); };
+		size_t println(double n, int digits = 2) { return print(n, digits) + println(); };
+};
+
+class Stream : public Print {
+	public:
+		virtual int available(void) = 0;
+		virtual int read(void) = 0;
+		virtual int peek(void) { return -1; };
+		virtual void flush(void) {};
+};
+
+// Serial maps to stdout; nothing is ever available to read.
+class HostSerial : public Stream {
+	public:
+		void begin(unsigned long baud) {};
+		void setBufferSize(unsigned int tx, unsigned int rx) {};
+		size_t write(uint8_t c);
+		size_t write(const uint8_t *buf, size_t size);
+		using Print::write;
+		int available(void) { return 0; };
+		int read(void) { return -1; };
+		void flush(void);
+};
+
+// IPv4 address, as used by the Energia network libraries
+class IPAddress {
+	private:
+		uint8_t _address[4];
+
+	public:
+		IPAddress() { memset(_address, 0, sizeof(_address)); };
+		IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _address[0] = a; _address[1] = b; _address[2] = c; _address[3] = d; };
+		uint8_t operator[](int index) const { return _address[index]; };
+		uint8_t &operator[](int index) { return _address[index]; };
+		bool operator==(const IPAddress &ip) const { return memcmp(_address, ip._address, sizeof(_address)) == 0; };
+};
+
+extern HostSerial Serial;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+#endif /* IRCBOTHOST_H */
@@ -0,0 +1,184 @@
+/* IrcBotPool - event loop for many IrcBot instances.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "IrcBotPool.h"
+
+#ifdef IRC_POOL_EPOLL
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+IrcBotPool::IrcBotPool()
+{
+	botCount = 0;
+#ifdef IRC_POOL_EPOLL
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+IrcBotPool::~IrcBotPool()
+{
+#ifdef IRC_POOL_EPOLL
+	if (epfd >= 0)
+		close(epfd);
+#endif
+}
+
+boolean IrcBotPool::add(IrcBotBase *bot)
+{
+	unsigned int i;
+
+	if (bot == NULL || botCount == IRC_POOL_MAX)
+		return false;
+	for (i=0; i < botCount; i++) {
+		if (bots[i] == bot)
+			return false;  // Already in the pool
+	}
+	bots[botCount] = bot;
+#ifdef IRC_POOL_EPOLL
+	botfd[botCount] = -1;
+	syncSocket(botCount);
+#endif
+	botCount++;
+	return true;
+}
+
+// Remove a bot; the last entry moves into its place.
+boolean IrcBotPool::remove(IrcBotBase *bot)
+{
+	unsigned int i;
+
+	for (i=0; i < botCount; i++) {
+		if (bots[i] == bot)
+			break;
+	}
+	if (i == botCount)
+		return false;
+
+#ifdef IRC_POOL_EPOLL
+	if (botfd[i] >= 0)
+		epoll_ctl(epfd, EPOLL_CTL_DEL, botfd[i], NULL);
+	botfd[i] = -1;
+#endif
+	botCount--;
+	if (i != botCount) {
+		bots[i] = bots[botCount];
+#ifdef IRC_POOL_EPOLL
+		// Re-register the moved bot's socket under its new index
+		botfd[i] = -1;
+		if (botfd[botCount] >= 0)
+			epoll_ctl(epfd, EPOLL_CTL_DEL, botfd[botCount], NULL);
+		syncSocket(i);
+#endif
+	}
+	return true;
+}
+
+#ifdef IRC_POOL_EPOLL
+/* Keep epoll in step with the bot's socket, which changes across reconnects, and with whether it is
+ * waiting on writability (a connect in progress, or egress the socket hasn't taken yet).  A closed
+ * socket has already left the epoll set, and its number may since have been reused by another bot in
+ * the pool, so it is only explicitly removed when nobody else holds that number.
+ */
+void IrcBotPool::syncSocket(unsigned int idx)
+{
+	struct epoll_event ev;
+	unsigned int i;
+	int fd = bots[idx]->getSocket();
+	uint32_t events = EPOLLIN | EPOLLRDHUP | (bots[idx]->pollWritable() ? EPOLLOUT : 0);
+
+	if (fd == botfd[idx]) {
+		if (fd >= 0 && events != botev[idx]) {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = events;
+			ev.data.u32 = idx;
+			epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+			botev[idx] = events;
+		}
+		return;
+	}
+	if (botfd[idx] >= 0) {
+		for (i=0; i < botCount; i++) {
+			if (i != idx && botfd[i] == botfd[idx])
+				break;
+		}
+		if (i == botCount)
+			epoll_ctl(epfd, EPOLL_CTL_DEL, botfd[idx], NULL);
+	}
+	botfd[idx] = fd;
+	botev[idx] = events;
+	if (fd >= 0) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = events;
+		ev.data.u32 = idx;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST)
+			epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	}
+}
+
+unsigned int IrcBotPool::run(unsigned long maxWait)
+{
+	struct epoll_event events[IRC_POOL_MAX];
+	boolean ready[IRC_POOL_MAX];
+	unsigned long timeout = maxWait, t;
+	unsigned int i, serviced = 0;
+	int n;
+
+	for (i=0; i < botCount; i++) {
+		syncSocket(i);
+		ready[i] = false;
+		t = bots[i]->pollTimeout();
+		if (t < timeout)
+			timeout = t;
+	}
+
+	do {
+		n = epoll_wait(epfd, events, IRC_POOL_MAX, timeout == IRC_POLL_IDLE ? -1 : (timeout > INT_MAX ? INT_MAX : (int)timeout));
+	} while (n < 0 && errno == EINTR);
+	while (n-- > 0) {
+		if (events[n].data.u32 < botCount)
+			ready[events[n].data.u32] = true;
+	}
+
+	for (i=0; i < botCount; i++) {
+		if (ready[i] || bots[i]->pollTimeout() == 0) {
+			bots[i]->loop();
+			syncSocket(i);
+			serviced++;
+		}
+	}
+	return serviced;
+}
+
+#else
+
+// No descriptors to wait on; check each bot once and move on so the sketch's own loop() keeps running.
+unsigned int IrcBotPool::run(unsigned long maxWait)
+{
+	unsigned int i, serviced = 0;
+
+	for (i=0; i < botCount; i++) {
+		if (bots[i]->hasInput() || bots[i]->pollWritable() || bots[i]->pollTimeout() == 0) {
+			bots[i]->loop();
+			serviced++;
+		}
+	}
+	return serviced;
+}
+
+#endif /* IRC_POOL_EPOLL */
@@ -0,0 +1,59 @@
+/* IrcBotPool - Drives many IrcBot instances from one event loop.  On a Linux host every bot's socket
+ * is registered with epoll and run() sleeps until one is readable or a bot's next timer is due; on
+ * a microcontroller run() makes a single readiness sweep instead.  Either way, only bots with input
+ * waiting or a due timer have their loop() called.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef IRCBOTPOOL_H
+#define IRCBOTPOOL_H
+
+#include "IrcBot.h"
+
+#ifndef IRC_POOL_MAX
+#define IRC_POOL_MAX 64
+#endif
+
+#if !defined(ENERGIA) && !defined(ARDUINO) && defined(__linux__)
+#define IRC_POOL_EPOLL 1
+#endif
+
+class IrcBotPool {
+	private:
+		IrcBotBase *bots[IRC_POOL_MAX];
+		unsigned int botCount;
+#ifdef IRC_POOL_EPOLL
+		int epfd;
+		int botfd[IRC_POOL_MAX];  // Socket currently registered with epoll for each bot, -1 = none
+		uint32_t botev[IRC_POOL_MAX];  // Events it is registered for
+		void syncSocket(unsigned int idx);
+#endif
+
+	public:
+		IrcBotPool();
+		~IrcBotPool();
+
+		boolean add(IrcBotBase *bot);
+		boolean remove(IrcBotBase *bot);
+		unsigned int count(void) { return botCount; };
+
+		/* Service every bot that has input or a due timer; returns how many were serviced.
+		 * With epoll, waits up to maxWait ms (IRC_POLL_IDLE = until something happens) first.
+		 * The readiness sweep never waits.
+		 */
+		unsigned int run(unsigned long maxWait = IRC_POLL_IDLE);
+};
+
+#endif /* IRCBOTPOOL_H */
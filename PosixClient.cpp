@@ -0,0 +1,238 @@
+/* PosixClient - non-blocking POSIX socket transport for running IrcBot on a Linux host.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#if !defined(ENERGIA) && !defined(ARDUINO)
+
+#include "PosixClient.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+PosixClient::PosixClient()
+{
+	_fd = -1;
+}
+
+PosixClient::~PosixClient()
+{
+	stop();
+}
+
+int PosixClient::resolve(const char *host, IPAddress &ip)
+{
+	struct addrinfo hints, *res;
+	const uint8_t *addr;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL)
+		return -2;
+	addr = (const uint8_t *)&((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+	ip = IPAddress(addr[0], addr[1], addr[2], addr[3]);
+	freeaddrinfo(res);
+	return 1;
+}
+
+// Like EthernetClient::connect(), these wait for the handshake to finish.
+int PosixClient::connect(const char *host, uint16_t port)
+{
+	IPAddress ip;
+
+	if (resolve(host, ip) != 1)
+		return -2;  // Name lookup failed
+	return connect(ip, port);
+}
+
+int PosixClient::connect(IPAddress ip, uint16_t port)
+{
+	int r;
+
+	r = connectAsync(ip, port);
+	if (r == 0) {
+		if (!waitWritable(POSIXCLIENT_CONNECT_TIMEOUT)) {
+			stop();
+			return -1;  // Timed out
+		}
+		r = connectPoll();
+	}
+	return r;
+}
+
+/* Start a connection without waiting for the handshake; the socket stays non-blocking from here on.
+ * Follow up with connectPoll() once the socket turns writable.
+ */
+int PosixClient::connectAsync(IPAddress ip, uint16_t port)
+{
+	struct sockaddr_in sa;
+	uint8_t *addr = (uint8_t *)&sa.sin_addr.s_addr;
+	int fd;
+
+	stop();
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	for (fd=0; fd < 4; fd++)
+		addr[fd] = ip[fd];  // Network byte order, same as IPAddress
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	_fd = fd;
+	if (::connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0)
+		return connectPoll();
+	if (errno == EINPROGRESS)
+		return 0;
+	stop();
+	return -1;
+}
+
+int PosixClient::connectPoll(void)
+{
+	struct pollfd pfd;
+	int err = -1, r;
+	socklen_t errlen = sizeof(err);
+
+	if (_fd < 0)
+		return -1;
+	pfd.fd = _fd;
+	pfd.events = POLLOUT;
+	r = poll(&pfd, 1, 0);
+	if (r == 0)
+		return 0;  // Handshake still in progress
+	if (r < 0 || getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0 || err != 0) {
+		stop();
+		return -1;
+	}
+	// IrcBot already coalesces what it sends; don't let Nagle hold back its replies
+	err = 1;
+	setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &err, sizeof(err));
+	return 1;
+}
+
+uint8_t PosixClient::connected(void)
+{
+	uint8_t c;
+	ssize_t r;
+
+	if (_fd < 0)
+		return 0;
+	r = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	if (r > 0)
+		return 1;
+	if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		stop();  // Peer closed the connection (or it failed) and nothing is left to read
+		return 0;
+	}
+	return 1;
+}
+
+int PosixClient::available(void)
+{
+	int n = 0;
+
+	if (_fd < 0 || ioctl(_fd, FIONREAD, &n) < 0)
+		return 0;
+	return n;
+}
+
+int PosixClient::read(void)
+{
+	uint8_t c;
+
+	if (read(&c, 1) == 1)
+		return c;
+	return -1;
+}
+
+int PosixClient::read(uint8_t *buf, size_t size)
+{
+	ssize_t r;
+
+	if (_fd < 0)
+		return -1;
+	r = recv(_fd, buf, size, MSG_DONTWAIT);
+	if (r > 0)
+		return r;
+	if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return -1;
+	stop();
+	return -1;
+}
+
+int PosixClient::peek(void)
+{
+	uint8_t c;
+
+	if (_fd < 0 || recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+		return -1;
+	return c;
+}
+
+size_t PosixClient::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+/* Returns however much the socket buffer took, possibly 0; never waits.  IrcBot keeps the rest and
+ * retries once the socket is writable again.
+ */
+size_t PosixClient::write(const uint8_t *buf, size_t size)
+{
+	ssize_t r;
+
+	if (_fd < 0 || size == 0)
+		return 0;
+	do {
+		r = send(_fd, buf, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (r < 0 && errno == EINTR);
+	if (r > 0)
+		return r;
+	if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+	stop();
+	return 0;
+}
+
+void PosixClient::stop(void)
+{
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+}
+
+boolean PosixClient::waitWritable(unsigned long timeout)
+{
+	struct pollfd pfd;
+	int r;
+
+	pfd.fd = _fd;
+	pfd.events = POLLOUT;
+	do {
+		r = poll(&pfd, 1, timeout);
+	} while (r < 0 && errno == EINTR);
+	return r > 0 && (pfd.revents & POLLOUT);
+}
+
+#endif /* !ENERGIA && !ARDUINO */
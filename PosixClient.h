@@ -0,0 +1,53 @@
+/* PosixClient - TCP client for Linux hosts with the same surface IrcBot uses from EthernetClient
+ * (connect/connected/available/read/write/stop), backed by a non-blocking socket.
+ *
+ * Copyright (c) 2014, Eric Brundick <spirilis@linux.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright notice
+ * and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT,
+ * OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef POSIXCLIENT_H
+#define POSIXCLIENT_H
+
+#include "IrcBotHost.h"
+
+#define POSIXCLIENT_CONNECT_TIMEOUT 10000  // ms the blocking connect() waits for the TCP handshake
+
+class PosixClient : public Stream {
+	private:
+		int _fd;
+		boolean waitWritable(unsigned long timeout);
+
+	public:
+		PosixClient();
+		~PosixClient();
+
+		int connect(const char *host, uint16_t port);  // 1 on success, negative on failure
+		int connect(IPAddress ip, uint16_t port);
+		int connectAsync(IPAddress ip, uint16_t port);  // 1 connected, 0 in progress, negative on failure
+		int connectPoll(void);  // Progress of connectAsync(); same return values, closes the socket on failure
+		static int resolve(const char *host, IPAddress &ip);  // IPv4 lookup; 1 on success
+		uint8_t connected(void);  // True while the socket is open or unread data remains
+		int available(void);
+		int read(void);
+		int read(uint8_t *buf, size_t size);  // -1 if nothing is waiting; never blocks
+		int peek(void);
+		size_t write(uint8_t c);
+		size_t write(const uint8_t *buf, size_t size);  // Bytes the socket took, 0 if its buffer is full; never blocks
+		using Print::write;
+		void flush(void) {};
+		void stop(void);
+		int fd(void) { return _fd; };  // Underlying socket, -1 when closed
+		operator bool() { return _fd >= 0; };
+};
+
+#endif /* POSIXCLIENT_H */
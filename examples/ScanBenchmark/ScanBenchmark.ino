@@ -0,0 +1,85 @@
+/* ScanBenchmark - Compares the old byte-at-a-time ring buffer search against ircScanDelim().
+ * No network connection is needed; results are printed to Serial in bytes per CPU cycle.
+ */
+#include <IrcBot.h>
+#include <Ethernet.h>
+#include <EthernetClient.h>
+
+#ifndef F_CPU
+#define F_CPU 120000000UL
+#endif
+
+#define RING_LEN 1024
+#define ITERATIONS 200
+
+uint8_t ring[RING_LEN];
+unsigned int ringStart = RING_LEN - 100;  // Data wraps around the end of the ring like it does live
+
+// Same loop shape as the pre-ircScanDelim ringBufferSearch(); one modulo and compare per byte.
+int legacySearch(unsigned int start, unsigned int len, uint8_t search)
+{
+  unsigned int i;
+
+  for (i = start; i < start + len; i++) {
+    if (ring[i % RING_LEN] == search)
+      return i - start;
+  }
+  return -1;
+}
+
+// Two-span search as done by IrcBotBase::ringBufferFrameLine()
+int spanSearch(unsigned int start, unsigned int len)
+{
+  unsigned int span = len, found;
+
+  if (start + span > RING_LEN)
+    span = RING_LEN - start;
+  found = ircScanDelim(&ring[start], span, '\r', '\n');
+  if (found < span)
+    return found;
+  found = ircScanDelim(&ring[0], len - span, '\r', '\n');
+  if (found < len - span)
+    return span + found;
+  return -1;
+}
+
+void report(const char *name, uint32_t elapsed_us, uint32_t bytes)
+{
+  float cycles = (float)elapsed_us * (F_CPU / 1000000UL);
+
+  Serial.print(name); Serial.print(": ");
+  Serial.print(elapsed_us); Serial.print(" us, ");
+  Serial.print((float)bytes / cycles, 4); Serial.println(" bytes/cycle");
+}
+
+void setup() {
+  const char *names = "@ChanServ +Spirilis energia_bot alice bob carol dave eve mallory trent ";
+  unsigned int i, len = RING_LEN - 1;
+  uint32_t start, elapsed, bytes;
+  volatile int sink = 0;
+
+  Serial.begin(115200);
+  delay(1000);
+  Serial.println("ScanBenchmark - searching a full ring for the end of a NAMES burst line");
+
+  // A NAMES reply with no terminator in view; the worst case of a partial line sitting in the ring.
+  for (i=0; i < RING_LEN; i++)
+    ring[i] = names[i % strlen(names)];
+
+  bytes = (uint32_t)len * ITERATIONS;
+
+  start = micros();
+  for (i=0; i < ITERATIONS; i++)
+    sink += legacySearch(ringStart, len, '\r');
+  elapsed = micros() - start;
+  report("byte loop   ", elapsed, bytes);
+
+  start = micros();
+  for (i=0; i < ITERATIONS; i++)
+    sink += spanSearch(ringStart, len);
+  elapsed = micros() - start;
+  report("ircScanDelim", elapsed, bytes);
+}
+
+void loop() {
+}
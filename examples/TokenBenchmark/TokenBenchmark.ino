@@ -0,0 +1,75 @@
+/* TokenBenchmark - Measures command verb lookup speed (tokens/sec) for the old strcmp() chain
+ * versus IrcBot::ircProtocolCommandToken().  No network connection is needed.
+ */
+#include <IrcBot.h>
+#include <Ethernet.h>
+#include <EthernetClient.h>
+
+#define ITERATIONS 2000
+
+// A join/part heavy line mix, as seen on a busy channel
+const char *verbs[] = {
+  "JOIN", "PART", "JOIN", "QUIT", "PRIVMSG", "JOIN", "PART", "PING",
+  "KICK", "NICK", "MODE", "PRIVMSG", "NOTICE", "JOIN", "PART", "353"
+};
+#define VERB_COUNT (sizeof(verbs) / sizeof(verbs[0]))
+
+// The lookup as it was before the packed-key switch
+int legacyToken(const char *cmd)
+{
+  if (cmd[0] >= '0' && cmd[0] <= '9') {
+    return atoi(cmd);
+  } else {
+    if (!strcmp(cmd, "PRIVMSG")) return IRC_CMDTOKEN_PRIVMSG;
+    if (!strcmp(cmd, "NOTICE")) return IRC_CMDTOKEN_NOTICE;
+    if (!strcmp(cmd, "PASS")) return IRC_CMDTOKEN_PASS;
+    if (!strcmp(cmd, "NICK")) return IRC_CMDTOKEN_NICK;
+    if (!strcmp(cmd, "USER")) return IRC_CMDTOKEN_USER;
+    if (!strcmp(cmd, "OPER")) return IRC_CMDTOKEN_OPER;
+    if (!strcmp(cmd, "MODE")) return IRC_CMDTOKEN_MODE;
+    if (!strcmp(cmd, "SERVICE")) return IRC_CMDTOKEN_SERVICE;
+    if (!strcmp(cmd, "QUIT")) return IRC_CMDTOKEN_QUIT;
+    if (!strcmp(cmd, "JOIN")) return IRC_CMDTOKEN_JOIN;
+    if (!strcmp(cmd, "PART")) return IRC_CMDTOKEN_PART;
+    if (!strcmp(cmd, "TOPIC")) return IRC_CMDTOKEN_TOPIC;
+    if (!strcmp(cmd, "INVITE")) return IRC_CMDTOKEN_INVITE;
+    if (!strcmp(cmd, "KICK")) return IRC_CMDTOKEN_KICK;
+    if (!strcmp(cmd, "PING")) return IRC_CMDTOKEN_PING;
+    if (!strcmp(cmd, "PONG")) return IRC_CMDTOKEN_PONG;
+  }
+  return -1;
+}
+
+void report(const char *name, uint32_t elapsed_us)
+{
+  uint32_t tokens = (uint32_t)ITERATIONS * VERB_COUNT;
+
+  Serial.print(name); Serial.print(": ");
+  Serial.print(elapsed_us); Serial.print(" us, ");
+  Serial.print((float)tokens * 1000000.0 / elapsed_us, 0); Serial.println(" tokens/sec");
+}
+
+void setup() {
+  unsigned int i, j;
+  uint32_t start;
+  volatile int sink = 0;
+
+  Serial.begin(115200);
+  delay(1000);
+  Serial.println("TokenBenchmark - command verb to IRC_CMDTOKEN_* lookup");
+
+  start = micros();
+  for (i=0; i < ITERATIONS; i++)
+    for (j=0; j < VERB_COUNT; j++)
+      sink += legacyToken(verbs[j]);
+  report("strcmp chain  ", micros() - start);
+
+  start = micros();
+  for (i=0; i < ITERATIONS; i++)
+    for (j=0; j < VERB_COUNT; j++)
+      sink += IrcBot::ircProtocolCommandToken(verbs[j]);
+  report("packed switch ", micros() - start);
+}
+
+void loop() {
+}
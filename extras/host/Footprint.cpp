@@ -0,0 +1,37 @@
+/* Footprint - Prints the memory each bot configuration takes, as sizeof sees it.
+ * Usage: make footprint
+ */
+#include <IrcBot.h>
+#include <stdio.h>
+
+// A LaunchPad bot that sits in one channel and answers a few commands
+struct TinyBotConfig : IrcBotConfig {
+  static const unsigned int Channels = 1, UserCallbacks = 0, Commands = 4, Members = 0;
+  static const unsigned int IngressBuffer = 600, EgressBuffer = 512, EgressQueueLines = 4, EgressQueueBytes = 512;
+};
+
+// One of many identities in an IrcBotPool (see PoolBot.cpp)
+struct PoolBotConfig : IrcBotConfig {
+  static const unsigned int Channels = 2, UserCallbacks = 0, Commands = 4, Members = 0;
+};
+
+// A host bot watching a lot of busy channels
+struct LargeBotConfig : IrcBotConfig {
+  static const unsigned int Channels = 64, Commands = 128, Members = 16384, Nicks = 8192;
+  static const unsigned int IngressBuffer = 8192, EgressQueueLines = 64, EgressQueueBytes = 8192;
+};
+
+static void report(const char *name, size_t size)
+{
+  printf("%-32s %8zu bytes\n", name, size);
+}
+
+int main(void)
+{
+  report("IrcBotBase (state, no tables)", sizeof(IrcBotBase));
+  report("IrcBot (IrcBotConfig defaults)", sizeof(IrcBot));
+  report("BasicIrcBot<TinyBotConfig>", sizeof(BasicIrcBot<TinyBotConfig>));
+  report("BasicIrcBot<PoolBotConfig>", sizeof(BasicIrcBot<PoolBotConfig>));
+  report("BasicIrcBot<LargeBotConfig>", sizeof(BasicIrcBot<LargeBotConfig>));
+  return 0;
+}
@@ -0,0 +1,50 @@
+/* HostBot - BasicResponse built as a Linux program on top of PosixClient.
+ * Usage: hostbot <server> [port] [nick] [channel]
+ */
+#include <IrcBot.h>
+#include <stdio.h>
+
+IrcBot irc;
+boolean running = true;
+
+void HandleHi(void *userobj, const char *chan, const char *nick, const char *message)
+{
+  char tmpbuf[IRC_NICKUSER_MAXLEN + 32];
+
+  strcpy(tmpbuf, "Hi there, ");
+  strcat(tmpbuf, nick);
+  strcat(tmpbuf, "!");
+  irc.sendPrivmsg(chan, nick, tmpbuf);
+}
+
+void KillBot(void *userobj, const char *chan, const char *nick, const char *message)
+{
+  irc.sendPrivmsg(chan, NULL, "Bye for now!");
+  irc.end();
+  running = false;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <server> [port] [nick] [channel]\n", argv[0]);
+    return 1;
+  }
+  irc.setServer(argv[1]);
+  if (argc > 2)
+    irc.setPort(atoi(argv[2]));
+  if (argc > 3)
+    irc.setNick(argv[3]);
+  irc.addChannel(argc > 4 ? argv[4] : "#energia");
+
+  irc.attachOnCommand("hi", HandleHi, NULL);
+  irc.attachOnCommand("die", KillBot, NULL);
+  irc.begin();
+
+  while (running) {
+    irc.loop();
+    Serial.flush();
+    delay(10);
+  }
+  return 0;
+}
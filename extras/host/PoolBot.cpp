@@ -0,0 +1,54 @@
+/* PoolBot - Runs many bot identities against one server from a single IrcBotPool event loop.
+ * Usage: poolbot <server> <port> <count> [nickprefix] [channel]
+ */
+#include <IrcBotPool.h>
+#include <stdio.h>
+
+IrcBotPool pool;
+
+// Each identity sits in one channel and answers one command; no need for the default tables
+struct PoolBotConfig : IrcBotConfig {
+  static const unsigned int Channels = 2, UserCallbacks = 0, Commands = 4, Members = 0;
+};
+typedef BasicIrcBot<PoolBotConfig> PoolBot;
+
+void HandleHi(void *userobj, const char *chan, const char *nick, const char *message)
+{
+  PoolBot *bot = (PoolBot *)userobj;
+
+  bot->sendPrivmsg(chan, nick, "Hi there!");
+}
+
+int main(int argc, char **argv)
+{
+  char nick[IRC_NICKUSER_MAXLEN];
+  PoolBot *bot;
+  int i, count;
+
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s <server> <port> <count> [nickprefix] [channel]\n", argv[0]);
+    return 1;
+  }
+  count = atoi(argv[3]);
+  if (count < 1 || count > IRC_POOL_MAX) {
+    fprintf(stderr, "count must be 1-%d\n", IRC_POOL_MAX);
+    return 1;
+  }
+
+  for (i=0; i < count; i++) {
+    bot = new PoolBot();
+    snprintf(nick, sizeof(nick), "%s%d", argc > 4 ? argv[4] : "PoolBot", i);
+    bot->setDebug(NULL);
+    bot->setServer(argv[1]);
+    bot->setPort(atoi(argv[2]));
+    bot->setNick(nick);
+    bot->addChannel(argc > 5 ? argv[5] : "#energia");
+    bot->attachOnCommand("hi", HandleHi, bot);
+    bot->begin();
+    pool.add(bot);
+  }
+
+  while (1)
+    pool.run();
+  return 0;
+}